@@ -0,0 +1,140 @@
+/*!
+ * \file BuildContext.hpp
+ *
+ * \brief State shared by every ComputationBuilder working on one translation
+ * unit
+ */
+
+#ifndef SPFIE_BUILDCONTEXT_HPP
+#define SPFIE_BUILDCONTEXT_HPP
+
+#include <map>
+#include <set>
+#include <string>
+
+#include "FunctionIndex.hpp"
+#include "PositionContext.hpp"
+#include "SourceTextCache.hpp"
+#include "SummaryStore.hpp"
+#include "SymbolTable.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/*!
+ * \struct BuildOptions
+ *
+ * \brief Settings for how Computations are built, which affect the results
+ */
+struct BuildOptions {
+  //! Value of a limit which is not imposed
+  static const unsigned int Unlimited = ~0u;
+
+  //! How many levels of nested calls may be inlined; calls nested more
+  //! deeply are outlined. At 1, only calls made directly from the function
+  //! being translated are inlined, and at 0 none are.
+  unsigned int maxInlineDepth = Unlimited;
+  //! How many statements a Computation may grow to by inlining calls;
+  //! calls which would grow it beyond this are outlined
+  unsigned int inlineBudget = Unlimited;
+  //! Whether to merge runs of consecutive statements in the same position
+  //! (with no loop, if or call between them) which do not depend on each
+  //! other into one macro statement, so that codegen has fewer statements to
+  //! schedule. Statements which access a data space another in the run
+  //! writes are kept separate, as SSA and dependence analysis need them to be.
+  bool mergeStmts = false;
+  //! Whether to leave declarations without initializers, like "int i;", out
+  //! of the Computation rather than making statements of them. The types
+  //! they declare are still given to the data spaces they name, when those
+  //! are accessed.
+  bool foldDeclarations = false;
+  //! Whether to remove duplicate and implied constraints from the iteration
+  //! spaces of the finished Computation (see ConstraintSimplifier)
+  bool simplifyConstraints = false;
+
+  //! Describe the options which differ from the defaults, for use in cache
+  //! keys
+  std::string describe() const;
+
+  //! Describe the options which differ from the defaults and change the
+  //! Computation built from a called function on its own, for use in
+  //! summary keys (see SummaryStore)
+  std::string describeCalleeSettings() const;
+};
+
+/*!
+ * \struct BuildContext
+ *
+ * \brief Mutable state for building Computations from one translation unit.
+ *
+ * The top-level ComputationBuilder and all the builders it spawns for inlined
+ * functions share one BuildContext. Separate BuildContexts share no state, so
+ * translation units may be processed concurrently as long as each gets its
+ * own.
+ */
+struct BuildContext {
+  BuildContext();
+
+  ~BuildContext();
+
+  BuildContext(const BuildContext &) = delete;
+  BuildContext &operator=(const BuildContext &) = delete;
+
+  //! Source text of the statements processed, active while this exists
+  SourceTextCache sourceText;
+
+  //! Computations referenced from any others, stored for potential re-use
+  std::map<std::string, iegenlib::Computation *> subComputations;
+
+  //! Functions referenced from any others which have been scanned and found
+  //! translatable, stored as name -> whether they return a value
+  std::map<std::string, bool> scannedSubFunctions;
+
+  //! Functions referenced from any others which have been scanned in place
+  //! of building them (see ComputationBuilder::scanSubFunction), stored as
+  //! name -> number of statements in their bodies
+  std::map<std::string, unsigned int> subFunctionSizes;
+
+  //! Index of functions defined in other files, to inline calls to them;
+  //! only functions defined in this translation unit are inlined when null
+  FunctionIndex *functionIndex = nullptr;
+
+  //! Stored summaries of called functions, to use in place of building
+  //! them; none are used when null
+  SummaryStore *summaries = nullptr;
+
+  //! Settings for building
+  BuildOptions options;
+
+  //! Number of calls the function being built is nested in (0 for the
+  //! function being translated)
+  unsigned int inlineDepth = 0;
+
+  //! Calls which were outlined rather than inlined, as called function
+  //! name -> locations of the calls
+  std::map<std::string, std::set<std::string>> outlinedCalls;
+
+  //! Interned names of the variables seen so far
+  SymbolTable symbols;
+
+  //! Context information about the position we're currently at.
+  //! Updated to the most recent statement in the Computation currently being processed.
+  PositionContext positionContext;
+
+  //! Get a unique variable name to use in substitutions
+  std::string getVarReplacementName();
+
+  //! Number replacement variable names from the given number on
+  //! \param[in] next Number of the next name to hand out
+  //! \return The number which would otherwise have been used next
+  unsigned int restartVarReplacementNames(unsigned int next = 0);
+
+private:
+  //! Number to be used (and incremented) when creating replacement variable
+  //! names
+  unsigned int replacementVarNumber = 0;
+};
+
+}  // namespace spf_ie
+
+#endif
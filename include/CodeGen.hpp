@@ -0,0 +1,59 @@
+/*!
+ * \file CodeGen.hpp
+ *
+ * \brief Generation of C code from a finalized Computation, with either
+ * Omega (through IEGenLib) or isl's AST builder.
+ */
+
+#ifndef SPFIE_CODEGEN_HPP
+#define SPFIE_CODEGEN_HPP
+
+#include <string>
+
+#include "iegenlib.h"
+#include "llvm/Support/Error.h"
+
+namespace spf_ie {
+
+//! Library generating the loop nests
+enum class CodeGenBackend {
+  //! Omega, through Computation::codeGen()
+  Omega,
+  //! isl's AST builder, falling back to Omega for Computations it cannot
+  //! represent
+  Isl
+};
+
+/*!
+ * \class CodeGen
+ *
+ * \brief Generates C code for a Computation with the chosen backend.
+ *
+ * Both backends define a macro for each statement, named s0, s1 and so on,
+ * and scan the statements' iteration spaces in the order of their execution
+ * schedules, calling the macros from the loop nest. isl cannot take
+ * uninterpreted function calls, as in the iteration spaces of sparse
+ * computations, so those are left to Omega.
+ */
+class CodeGen {
+public:
+  CodeGen() = delete;
+
+  //! Generate code for a Computation
+  //! \param[in] computation Computation to generate code for, which must
+  //! have been finalized
+  //! \param[in] backend Backend to generate the loop nests with
+  //! \return The code
+  static std::string generate(iegenlib::Computation *computation, CodeGenBackend backend);
+
+  //! Generate code for a Computation with isl
+  //! \param[in] computation Computation to generate code for, which must
+  //! have been finalized
+  //! \return The code, or an error if isl cannot represent some statement's
+  //! iteration space or execution schedule
+  static llvm::Expected<std::string> generateWithIsl(iegenlib::Computation *computation);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -2,15 +2,22 @@
 #define SPFIE_SPFCOMPUTATIONBUILDER_HPP
 
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 #include <map>
 
+#include "BuildContext.hpp"
+#include "FunctionIndex.hpp"
+#include "FunctionScan.hpp"
 #include "PositionContext.hpp"
+#include "SPFPrinter.hpp"
+#include "SymbolTable.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/Stmt.h"
 #include "iegenlib.h"
+#include "llvm/Support/Error.h"
 
 using namespace clang;
 
@@ -22,42 +29,81 @@ namespace spf_ie {
  * \brief Class handling building up the sparse polyhedral model for a function
  *
  * Contains the entry point for function processing. Recursively visits each
- * statement in the source.
+ * statement in the source. Builders for inlined functions share the top-level
+ * builder's BuildContext.
  */
 class ComputationBuilder {
 public:
-  ComputationBuilder();
+  //! \param[in] build State shared with any other builders for the same translation unit
+  explicit ComputationBuilder(BuildContext &build);
 
   //! Entry point for building top-level Computation.
   //! Gathers information about the function's
   //! statements and data accesses into a Computation.
   //! \param[in] funcDecl Function declaration to process
-  Computation *buildComputationFromFunction(
+  //! \return The Computation, owned by the caller, or an SPFError if the
+  //! function (or one it calls) cannot be represented
+  llvm::Expected<Computation *> buildComputationFromFunction(
       FunctionDecl *funcDecl);
 
-  //! Computations referenced from any others, stored for potential re-use
-  static std::map<std::string, Computation *> subComputations;
-
-  //! Context information about the position we're currently at.
-  //! Updated to the most recent statement in the Computation currently being processed.
-  static PositionContext *positionContext;
+  //! Check whether a function can be built into a Computation, making the
+  //! same checks as buildComputationFromFunction (including of the functions
+  //! it calls) but building no Computation.
+  //! \param[in] funcDecl Function declaration to check
+  //! \return Counts of the function's contents, or an SPFError if the
+  //! function (or one it calls) cannot be represented
+  llvm::Expected<FunctionScan> scanFunction(FunctionDecl *funcDecl);
 
   //! Names of reserved (standard library) functions that should not be inlined.
   //! When one of these is encountered, its arguments will be marked as read from, and no other processing will occur.
   const static std::unordered_set<std::string> reservedFuncNames;
 
 private:
-  //! Top-level Computation being built up
-  Computation *computation;
+  //! State shared with other builders for the same translation unit
+  BuildContext &build;
+  //! Whether the function is only being checked, with no Computation built
+  bool scanning = false;
+  //! Counts of the function's contents
+  FunctionScan scan;
+  //! Number of for loops enclosing the current position
+  unsigned int loopDepth = 0;
+  //! Number of calls outlined rather than inlined
+  unsigned int numCallsOutlined = 0;
+  //! Top-level Computation being built up, unless scanning
+  Computation *computation = nullptr;
   //! Whether a return Stmt has been hit in this function
   bool haveFoundAReturn = false;
+  //! Data spaces known to be in the Computation
+  SymbolSet knownDataSpaces;
   //! Declarations found, which may need to be consulted for type info later
   std::map<std::string, QualType> varDecls;
   //! Data accesses for statement currently being processed
   DataAccessHandler dataAccesses;
-  //! String replacement rules to be applied for current statement, stored as from->to.
+  //! Text to print in place of calls in the current statement.
   //! Currently only used to replace calls to inline functions with their return values.
-  std::map<std::string, std::string> stmtSourceCodeReplacements;
+  CallReplacements stmtSourceCodeReplacements;
+  //! Whether the statement currently being processed contains an outlined call
+  bool stmtHasOutlinedCall = false;
+  //! Statement which the following ones may be merged into, when
+  //! BuildOptions::mergeStmts is set, or null if there is none
+  iegenlib::Stmt *macroStmt = nullptr;
+  //! Data spaces read by the statements merged into macroStmt
+  std::set<std::string> macroStmtReads;
+  //! Data spaces written by the statements merged into macroStmt
+  std::set<std::string> macroStmtWrites;
+
+  //! Build a Computation from a function, throwing an SPFError if it cannot
+  //! be represented
+  //! \param[in] funcDecl Function declaration to process
+  Computation *buildComputation(FunctionDecl *funcDecl);
+
+  //! Check a function as scanFunction does, throwing an SPFError if it
+  //! cannot be represented
+  //! \param[in] funcDecl Function declaration to check
+  FunctionScan scanOnly(FunctionDecl *funcDecl);
+
+  //! Get the body of a function to process, and reset the position to its start
+  CompoundStmt *beginFunction(FunctionDecl *funcDecl);
 
   //! Process the body of a control structure, such as a for loop
   //! \param[in] stmt Body statement (which may be compound) to process
@@ -71,12 +117,77 @@ private:
   //! \param[in] stmt Completed statement to save
   void addStmt(clang::Stmt *stmt);
 
+  //! Check whether a statement is a declaration left out of the
+  //! Computation, as BuildOptions::foldDeclarations has those without
+  //! initializers be
+  bool isFoldedDeclaration(clang::Stmt *stmt) const;
+
+  //! Check whether the current statement can be merged into macroStmt: it
+  //! must directly follow it in the same position, and neither statement may
+  //! access a data space the other writes
+  bool canMergeIntoMacroStmt() const;
+
+  //! Add the data spaces the current statement accesses to those of
+  //! macroStmt, against which later statements are checked
+  void recordMacroStmtAccesses();
+
+  //! Add the data accesses of the current statement to an IEGenLib statement
+  void addStmtDataAccesses(iegenlib::Stmt *stmt);
+
   //! Handle a return statement in the function
   void processReturnStmt(clang::ReturnStmt *returnStmt);
 
   //! Inline a nested function call and get its return value, if any
   std::string inlineFunctionCall(CallExpr *callExpr);
 
+  //! Leave a call in place as an opaque part of its statement instead of
+  //! inlining it, as when inlining it would exceed the limits in the
+  //! BuildOptions. The callee is still checked (see scanSubFunction).
+  //! \param[in] callExpr Call to outline
+  //! \param[in] callArgs Arguments of the call
+  //! \param[in] callArgStrings Source code of the arguments
+  //! \return An empty string, as the call's value is not replaced
+  std::string outlineFunctionCall(CallExpr *callExpr, const std::vector<clang::Expr *> &callArgs,
+                                  const std::vector<std::string> &callArgStrings);
+
+  //! Find the definition of a called function, in this translation unit or
+  //! (with an index) another, raising an SPFError if there is none
+  FunctionIndex::Definition findCalleeDefinition(FunctionDecl *callee, CallExpr *callExpr);
+
+  //! Build the Computation for a called function, or load its summary if
+  //! summaries are in use and one is stored
+  //! \param[in] callee Called function, as declared at the call
+  //! \param[in] callExpr Call, to report errors at
+  //! \return The Computation, owned by the caller
+  Computation *buildSubComputation(FunctionDecl *callee, CallExpr *callExpr);
+
+  //! Check a called function as scanning does, without building it,
+  //! raising an SPFError if it could not be inlined. Outlined calls must pass
+  //! this too: their statements only access the calls' arguments, so a
+  //! callee may access no data space but its parameters and locals (such as
+  //! a global), as inlining would also insist.
+  //! \param[in] callee Called function, as declared at the call
+  //! \param[in] callExpr Call, to report errors at
+  //! \return The number of statements in the function's body, not counting
+  //! those of the functions it calls in turn, to judge whether inlining it
+  //! fits the budget
+  unsigned int scanSubFunction(FunctionDecl *callee, CallExpr *callExpr);
+
+  //! Check a called function in place of inlining it, when scanning
+  //! \param[in] calleeName Name of the called function
+  //! \param[in] calleeDefinition Definition of the called function
+  //! \return A stand-in for the function's return value, if it has one
+  std::string scanFunctionCall(const std::string &calleeName, const FunctionIndex::Definition &calleeDefinition);
+
+  //! Check whether a name is a data space of the Computation, remembering
+  //! the answer so that the Computation is asked at most once per data space
+  bool isDataSpace(const std::string &name);
+
+  //! Add any data spaces accessed by the current statement which are new to
+  //! the Computation
+  //! \param[in] stmt Statement being added, to report errors at
+  void addStmtDataSpaces(clang::Stmt *stmt);
+
   //! Perform processing on a compound expression, including inlining any function calls.
   //! \param[in] expr Expression to process
   //! \param[in] processReads If true, also add any referenced data spaces as reads,
@@ -0,0 +1,51 @@
+/*!
+ * \file ConstraintSimplifier.hpp
+ *
+ * \brief Removal of duplicate and implied constraints from the iteration
+ * spaces of a Computation, to cut the work codegen does on them.
+ */
+
+#ifndef SPFIE_CONSTRAINTSIMPLIFIER_HPP
+#define SPFIE_CONSTRAINTSIMPLIFIER_HPP
+
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/*!
+ * \class ConstraintSimplifier
+ *
+ * \brief Simplifies the constraints of each statement's iteration space.
+ *
+ * Nested if conditions are stacked on the loop bounds as they are, and
+ * inlining brings in the caller's constraints again alongside the callee's,
+ * so iteration spaces often hold constraints which say nothing new. Within
+ * each conjunction, constraints which differ only in their constant term
+ * are compared directly:
+ * - duplicate equalities are removed, whichever side they were written from;
+ * - of inequalities bounding the same expression, only the tightest is kept;
+ * - inequalities implied by an equality are removed;
+ * - a pair of inequalities bounding an expression from both sides to the
+ *   same value becomes an equality.
+ *
+ * Nothing is done about constraints implied only by combining several
+ * others, which would take a full (and far slower) satisfiability check.
+ */
+class ConstraintSimplifier {
+public:
+  //! Simplify the iteration space of every statement in a Computation
+  //! \param[in] computation Computation to simplify
+  //! \return Number of constraints removed
+  static unsigned int simplify(iegenlib::Computation *computation);
+
+  //! Simplify the constraints of a set
+  //! \param[in] set Set to simplify
+  //! \param[out] numRemoved Number of constraints removed
+  //! \return The simplified set, owned by the caller, or null if nothing
+  //! could be removed
+  static iegenlib::Set *simplify(const iegenlib::Set *set, unsigned int &numRemoved);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -16,6 +16,12 @@ using namespace clang;
 
 namespace spf_ie {
 
+struct PositionContext;
+
+//! Position of a DataAccess among the accesses it was made with, which
+//! together form a graph of accesses and the sub-accesses used as their indexes
+using DataAccessId = unsigned int;
+
 /*!
  * \struct DataAccess
  *
@@ -24,25 +30,48 @@ namespace spf_ie {
  * Used partly because the AST's representation of a multidimensional array access
  * is difficult to work with for our purposes. This can represent either an array
  * subscript access or scalar access.
+ *
+ * Accesses made together are stored in one list, in which sub-accesses (array
+ * accesses used as indexes) come before the accesses they are used in. Each
+ * access refers to its sub-accesses and the access it is used in by their
+ * DataAccessIds, so they are found without searching.
  */
 struct DataAccess {
-  DataAccess(std::string name, int64_t sourceId, bool isRead, bool isArrayAccess, std::vector<Expr *> indexes)
-      : name(name), sourceId(sourceId), isRead(isRead), isArrayAccess(isArrayAccess), indexes(indexes) {}
+  //! ID marking the absence of an access
+  static const DataAccessId NoAccess = ~0u;
+
+  DataAccess(std::string name, bool isRead, bool isArrayAccess, std::vector<Expr *> indexes,
+             std::vector<DataAccessId> subaccesses = {})
+      : name(name), isRead(isRead), isArrayAccess(isArrayAccess), indexes(indexes),
+        subaccesses(std::move(subaccesses)) {
+    this->subaccesses.resize(this->indexes.size(), NoAccess);
+  }
 
   //! Get a string representation of the data access, like A(i,j) for an array or x for a scalar.
-  //! \param[in] potentialSubaccesses Other array accesses here, which may be used as indexes in this one
-  std::string toString(const std::vector<DataAccess> &potentialSubaccesses) const;
+  //! \param[in] accesses Accesses this one was made with, including its sub-accesses
+  std::string toString(const std::vector<DataAccess> &accesses) const;
+
+  //! Get the sub-access used as one of this access's indexes
+  //! \param[in] indexPosition Position of the index
+  //! \param[in] accesses Accesses this one was made with
+  //! \return The sub-access, or nullptr if the index is not an array access
+  const DataAccess *getSubaccess(unsigned int indexPosition, const std::vector<DataAccess> &accesses) const;
 
   //! Name of base variable being accessed. In the case of an array, this will be the outermost access.
   std::string name;
-  //! ID of original AST node this represents
-  int64_t sourceId;
   //! Whether this access is a read or not (a write)
   bool isRead;
   //! Whether this access is an array (non-scalar) access.
   bool isArrayAccess;
   //! Indexes accessed in the data space
   std::vector<Expr *> indexes;
+  //! For each index, the ID of the sub-access it is, or NoAccess if it is not an array access
+  std::vector<DataAccessId> subaccesses;
+  //! ID of the access this one is an index of, or NoAccess if there is none
+  DataAccessId enclosingAccess = NoAccess;
+  //! For an access to every element of an array (which has no indexes), the
+  //! number of the array's dimensions; 0 otherwise
+  unsigned int wholeArrayDims = 0;
 };
 
 /*!
@@ -55,6 +84,10 @@ struct DataAccess {
  */
 struct DataAccessHandler {
 public:
+  //! \param[in] positionContext Position of the statement whose accesses are handled,
+  //! used to tell iterators apart from data spaces
+  explicit DataAccessHandler(const PositionContext *positionContext) : positionContext(positionContext) {}
+
   //! Add the space accessed (and any sub-accesses) as a read
   void processExprAsRead(Expr *expr);
 
@@ -67,18 +100,29 @@ public:
   //! Add a scalar's name as a write DataAccess.
   void processWriteToScalarName(const std::string &name);
 
+  //! Add an access to every element of an array, such as one whose pointer is
+  //! passed to a call left in place
+  //! \param[in] name Name of the array
+  //! \param[in] numDims Number of the array's dimensions
+  //! \param[in] isRead Whether this access is a read
+  void processAccessToWholeArray(const std::string &name, unsigned int numDims, bool isRead);
+
   //! Make all data accesses, including subaccesses, from the given expression
   //! \param[in] fullExpr Expression to process
   //! \param[in] isRead Whether this access is a read
+  //! \param[in] positionContext Position of the expression, used to skip iterators
   static std::vector<DataAccess> makeDataAccessesFromExpr(
-      Expr *fullExpr, bool isRead);
+      Expr *fullExpr, bool isRead, const PositionContext &positionContext);
 
-  //! Data accesses
+  //! Data accesses of the statement, forming its access graph (see DataAccess)
   std::vector<DataAccess> stmtDataAccesses;
   //! Data spaces accessed
   std::unordered_set<std::string> dataSpacesAccessed;
 
 private:
+  //! Position of the statement whose accesses are handled
+  const PositionContext *positionContext;
+
   //! Add a scalar's name as a DataAccess, as the given access type
   void processAccessToScalarName(const std::string &name, bool isRead);
 
@@ -92,7 +136,8 @@ private:
   //! \param[in] isRead Whether this access is a read
   //! \param[out] existingAccesses Current list of sub-accesses; after
   //! processing completes, the last element will be the outermost access.
-  static void doBuildArrayAccessWork(ArraySubscriptExpr *fullExpr,
+  //! \return ID of the outermost access
+  static DataAccessId doBuildArrayAccessWork(ArraySubscriptExpr *fullExpr,
                                      bool isRead,
                                      std::vector<DataAccess> &existingAccesses);
 
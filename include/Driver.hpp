@@ -1,13 +1,104 @@
 #ifndef SPFIE_DRIVER_HPP
 #define SPFIE_DRIVER_HPP
 
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "BuildContext.hpp"
+#include "CodeGen.hpp"
+#include "FunctionIndex.hpp"
+#include "FunctionScan.hpp"
 #include "clang/AST/ASTContext.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace spf_ie {
 
 //! Globally-accessible pointer to the ASTContext, initialized before the
-//! tool runs.
-extern const clang::ASTContext *Context;
+//! tool runs. Each thread has its own, so that translation units may be
+//! processed concurrently.
+extern thread_local const clang::ASTContext *Context;
+
+/*!
+ * \struct TranslationRequest
+ *
+ * \brief Which functions to translate from each input file, and what to
+ * output for them
+ */
+struct TranslationRequest {
+  //! Names of the functions to translate
+  std::vector<std::string> entryPoints;
+  //! Whether to translate every function defined in the input file instead
+  //! of just the entry points
+  bool allFunctions = false;
+  //! Whether to output Computation IR instead of codegen
+  bool frontendOnly = false;
+  //! Library to generate loop nests with, for codegen
+  CodeGenBackend codeGenBackend = CodeGenBackend::Omega;
+  //! Directory to write each function's result to, as its own file.
+  //! Results go to the output stream when this is empty.
+  std::string outputDir;
+  //! Directory of cached results to consult and add to; none is used when empty
+  std::string cacheDir;
+  //! Directory of summaries of called functions to consult and add to;
+  //! none is used when empty
+  std::string summaryDir;
+  //! Whether to only check which functions can be translated, recording a
+  //! ScanRecord for each instead of outputting anything
+  bool scan = false;
+  //! Settings for building Computations
+  BuildOptions buildOptions;
+  //! Index of functions defined in other files, to inline calls to them;
+  //! calls must be to functions defined in the same file when null
+  FunctionIndex *functionIndex = nullptr;
+
+  //! Describe the settings which affect translation results, for use in cache keys
+  std::string getCacheSettings() const;
+};
+
+/*!
+ * \struct ScanRecord
+ *
+ * \brief Whether one function can be translated, found with --scan
+ */
+struct ScanRecord {
+  //! File the function is defined in
+  std::string fileName;
+  //! Qualified name of the function
+  std::string functionName;
+  //! Whether the function can be translated
+  bool accepted = false;
+  //! Counts of the function's contents, if accepted
+  FunctionScan shape;
+  //! Why the function cannot be translated, if not accepted
+  std::string reason;
+  //! Location of the code which cannot be translated, or 0 if unknown
+  unsigned int line = 0;
+  unsigned int column = 0;
+};
+
+/*!
+ * \struct TranslationOutcome
+ *
+ * \brief What became of the requested functions, across all input files
+ */
+struct TranslationOutcome {
+  //! Requested entry points which were found in some input file
+  std::set<std::string> foundEntryPoints;
+  //! Errors for functions which could not be translated, and were skipped
+  std::vector<std::string> errors;
+  //! Results of scanning, when only scanning
+  std::vector<ScanRecord> scans;
+};
+
+//! Make a factory for Clang actions which translate each input file as requested
+//! \param[in] request What to translate, and what to output
+//! \param[out] out Stream receiving results which are not written to their own files
+//! \param[out] outcome Record of the functions found and those which failed
+std::unique_ptr<clang::tooling::FrontendActionFactory> newSPFActionFactory(
+    const TranslationRequest &request, llvm::raw_ostream &out, TranslationOutcome &outcome);
 
 }  // namespace spf_ie
 
@@ -1,13 +1,30 @@
 #ifndef SPFIE_EXECSCHEDULE_HPP
 #define SPFIE_EXECSCHEDULE_HPP
 
-#include <memory>
-#include <string>
-#include <vector>
+#include "SymbolTable.hpp"
+#include "llvm/ADT/SmallVector.h"
 
 namespace spf_ie {
 
-struct ScheduleVal;
+/*!
+ * \struct ScheduleVal
+ *
+ * \brief An entry of an execution schedule, which may be a variable or
+ * simply a number.
+ */
+struct ScheduleVal {
+  //! Make an entry holding an iterator
+  static ScheduleVal makeVar(SymbolId var) { return {var, 0, true}; }
+
+  //! Make an entry holding a number
+  static ScheduleVal makeNum(int num) { return {SymbolTable::NoSymbol, num, false}; }
+
+  //! Iterator, interned in the BuildContext's symbol table
+  SymbolId var;
+  int num;
+  //! Whether this ScheduleVal contains a variable
+  bool valueIsVar;
+};
 
 /*!
  * \struct ExecSchedule
@@ -15,11 +32,6 @@ struct ScheduleVal;
  * \brief An execution schedule tuple, plus a few utilities for it
  */
 struct ExecSchedule {
-  ExecSchedule() = default;
-
-  //! Copy constructor
-  ExecSchedule(const ExecSchedule &other);
-
   //! Add a value to the end of the schedule tuple
   void pushValue(const ScheduleVal &value);
 
@@ -36,24 +48,9 @@ struct ExecSchedule {
   //! Get the dimension of the execution schedule
   int getDimension() const { return scheduleTuple.size(); }
 
-  //! Actual execution schedule ordering tuple
-  std::vector<std::shared_ptr<ScheduleVal>> scheduleTuple;
-};
-
-/*!
- * \struct ScheduleVal
- *
- * \brief An entry of an execution schedule, which may be a variable or
- * simply a number.
- */
-struct ScheduleVal {
-  explicit ScheduleVal(std::string var);
-  explicit ScheduleVal(int num);
-
-  std::string var;
-  int num{};
-  //! Whether this ScheduleVal contains a variable
-  bool valueIsVar;
+  //! Actual execution schedule ordering tuple, held inline up to 16 entries
+  //! (a loop nest depth of 8)
+  llvm::SmallVector<ScheduleVal, 16> scheduleTuple;
 };
 
 }  // namespace spf_ie
@@ -0,0 +1,150 @@
+/*!
+ * \file FunctionIndex.hpp
+ *
+ * \brief Index of the functions defined in every file of a compilation
+ * database, for inlining calls to functions defined in other files.
+ */
+
+#ifndef SPFIE_FUNCTIONINDEX_HPP
+#define SPFIE_FUNCTIONINDEX_HPP
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/Error.h"
+
+namespace spf_ie {
+
+/*!
+ * \class FunctionIndex
+ *
+ * \brief Where each externally-visible function is defined, across all the
+ * files of a compilation database.
+ *
+ * Every file is parsed once up front to build the index. A file holding a
+ * definition that is needed is then parsed again, once, and its AST kept
+ * for the rest of the run, so any number of calls from any number of entry
+ * points reuse it.
+ *
+ * Definitions from other files may be used from several threads at once;
+ * work on them must hold a ForeignASTScope.
+ */
+class FunctionIndex {
+public:
+  /*!
+   * \struct Definition
+   *
+   * \brief A function definition and the AST it belongs to
+   */
+  struct Definition {
+    clang::FunctionDecl *decl = nullptr;
+    const clang::ASTContext *context = nullptr;
+  };
+
+  //! \param[in] compilations Compilation database giving compile flags for each file
+  explicit FunctionIndex(const clang::tooling::CompilationDatabase &compilations);
+
+  FunctionIndex(const FunctionIndex &) = delete;
+  FunctionIndex &operator=(const FunctionIndex &) = delete;
+
+  //! Parse the given files, indexing the functions defined in them
+  //! \param[in] files Paths of the files to index
+  //! \return Nonzero if some file could not be parsed, although the
+  //! definitions in the rest are indexed regardless
+  int build(const std::vector<std::string> &files);
+
+  //! Find the definition of a function declared but not defined in the
+  //! current translation unit, parsing the file it is in if need be
+  //! \param[in] declaration Declaration of the function, in the current
+  //! translation unit
+  //! \return The definition, whose decl is null if the function is not
+  //! indexed, or an error if it is defined in a way that cannot be used
+  llvm::Expected<Definition> findDefinition(const clang::FunctionDecl *declaration);
+
+  //! Get the source key of the summary (see SummaryStore::computeSourceKey)
+  //! of a function declared but not defined in the current translation unit,
+  //! without parsing the file it is defined in
+  //! \param[in] declaration Declaration of the function, in the current
+  //! translation unit
+  //! \return The key, or an empty string if the function has no usable
+  //! definition in the index
+  std::string getSummarySourceKey(const clang::FunctionDecl *declaration);
+
+  //! Number of functions indexed
+  size_t size() const;
+
+private:
+  friend class ForeignASTScope;
+  friend class IndexingConsumer;
+
+  /*!
+   * \struct Entry
+   *
+   * \brief One indexed function definition
+   */
+  struct Entry {
+    //! File the function is defined in
+    std::string fileName;
+    //! Canonical type of the function, as a string
+    std::string signature;
+    //! Source key of the function's summary, computed while indexing
+    std::string summarySourceKey;
+    //! The definition, once its file has been parsed again
+    Definition definition;
+  };
+
+  const clang::tooling::CompilationDatabase &compilations;
+  //! Definitions by qualified function name
+  std::map<std::string, std::vector<Entry>> entries;
+  //! ASTs of the files definitions have been needed from, by file name
+  std::map<std::string, std::unique_ptr<clang::ASTUnit>> units;
+  //! Held while looking up definitions and while working on their ASTs.
+  //! Recursive, since inlining a definition may need another.
+  std::recursive_mutex mutex;
+
+  //! Find the entry for the definition matching a declaration
+  //! \return The entry, or null if the function is not indexed, or an
+  //! error if the declaration matches no single definition
+  llvm::Expected<Entry *> findEntry(const clang::FunctionDecl *declaration);
+
+  //! Record a function definition found while indexing
+  void addDefinition(const clang::FunctionDecl *funcDecl, const std::string &fileName);
+
+  //! Get the AST of an indexed file, parsing it if not already done
+  //! \return The AST, or null if the file could not be parsed
+  clang::ASTUnit *getUnit(const std::string &fileName);
+};
+
+/*!
+ * \class ForeignASTScope
+ *
+ * \brief Makes the AST of a definition from another file the current one
+ * (see Context) while this exists, with exclusive use of it.
+ */
+class ForeignASTScope {
+public:
+  //! \param[in] index Index the definition was found in
+  //! \param[in] definition Definition to work on
+  ForeignASTScope(FunctionIndex &index, const FunctionIndex::Definition &definition);
+
+  ~ForeignASTScope();
+
+  ForeignASTScope(const ForeignASTScope &) = delete;
+  ForeignASTScope &operator=(const ForeignASTScope &) = delete;
+
+private:
+  std::lock_guard<std::recursive_mutex> lock;
+  //! AST which was current before this scope
+  const clang::ASTContext *outerContext;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,36 @@
+/*!
+ * \file FunctionScan.hpp
+ *
+ * \brief Shape of a function, as found when checking that it can be
+ * translated without building its Computation
+ */
+
+#ifndef SPFIE_FUNCTIONSCAN_HPP
+#define SPFIE_FUNCTIONSCAN_HPP
+
+namespace spf_ie {
+
+/*!
+ * \struct FunctionScan
+ *
+ * \brief Counts of a scanned function's contents. Those of inlined functions
+ * are not included.
+ */
+struct FunctionScan {
+  //! Statements which would be added to the Computation
+  unsigned int numStmts = 0;
+  //! For loops
+  unsigned int numLoops = 0;
+  //! Depth of the most deeply nested for loop
+  unsigned int maxLoopDepth = 0;
+  //! If statements, counting an else clause as another
+  unsigned int numIfs = 0;
+  //! Calls to functions which would be inlined
+  unsigned int numCallsInlined = 0;
+  //! Whether the function returns a value
+  bool returnsValue = false;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,53 @@
+/*!
+ * \file KernelGenerator.hpp
+ *
+ * \brief Generator of synthetic SPF-compatible C kernels, for measuring how
+ * translation scales with the shape of its input.
+ */
+
+#ifndef SPFIE_KERNELGENERATOR_HPP
+#define SPFIE_KERNELGENERATOR_HPP
+
+#include <string>
+
+namespace spf_ie {
+
+/*!
+ * \struct KernelShape
+ *
+ * \brief Parameters of a synthetic kernel, one per scaling axis
+ */
+struct KernelShape {
+  //! Number of statements in the innermost loop
+  unsigned int numStmts = 1;
+  //! Depth of the (perfect) loop nest, at least 1
+  unsigned int loopDepth = 1;
+  //! Number of nested if statements guarding the innermost statements
+  unsigned int numIfGuards = 0;
+  //! Number of calls to helper functions from the innermost loop
+  unsigned int callFanOut = 0;
+  //! Length of the chain of helper functions each call goes through, at least 1 when there are calls
+  unsigned int inliningDepth = 1;
+  //! Dimensionality of the arrays accessed, up to MAX_ARRAY_DIM
+  unsigned int arrayDim = 1;
+};
+
+/*!
+ * \class KernelGenerator
+ *
+ * \brief Writes C kernels of a given shape which spf-ie accepts.
+ */
+class KernelGenerator {
+public:
+  KernelGenerator() = delete;
+
+  //! Generate the source code of a kernel
+  //! \param[in] shape Shape of the kernel
+  //! \param[in] name Name of the kernel's entry point function
+  //! \return Source code, including any helper functions
+  static std::string generate(const KernelShape &shape, const std::string &name = "kernel");
+};
+
+}  // namespace spf_ie
+
+#endif
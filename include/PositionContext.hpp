@@ -12,44 +12,68 @@
 #define SPFIE_STMTCONTEXT_HPP
 
 #include <memory>
+#include <ostream>
 #include <stack>
 #include <string>
-#include <tuple>
 #include <vector>
 
 #include "DataAccessHandler.hpp"
 #include "ExecSchedule.hpp"
+#include "SymbolTable.hpp"
 #include "clang/AST/Expr.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/Stmt.h"
 
 using namespace clang;
 
+namespace iegenlib {
+class Exp;
+class Relation;
+class Set;
+}
+
 namespace spf_ie {
 
+struct BuildContext;
+
+/*!
+ * \struct Constraint
+ *
+ * \brief A constraint on iteration, such as "0 <= i" or "i < N", kept as the
+ * expressions it came from
+ */
+struct Constraint {
+  //! Left-hand side, or null when it is just the variable lowerVar
+  Expr *lower;
+  //! Variable on the left-hand side when lower is null, interned in the
+  //! BuildContext's symbol table
+  SymbolId lowerVar;
+  //! Right-hand side
+  Expr *upper;
+  //! Comparison between the two sides
+  BinaryOperatorKind oper;
+};
+
 /*!
  * \struct PositionContext
  *
  * \brief Contains information associated with a statement position, such as iteration
  * domain and execution schedule.
+ *
+ * What each enclosing control structure contributes is kept in a chain of
+ * immutable levels shared between copies, so a PositionContext can be saved
+ * and restored in constant time.
  */
 struct PositionContext {
-  PositionContext();
-
-  //! Variables being iterated over
-  std::vector<std::string> iterators;
-  //! Constraints on iteration -- inequalities and equalities
-  std::vector<std::shared_ptr<
-      std::tuple<std::string, std::string, BinaryOperatorKind>>>
-      constraints;
-  //! Execution schedule
+  //! \param[in] build BuildContext this position belongs to
+  explicit PositionContext(BuildContext *build);
+
+  //! Execution schedule values past those fixed by enclosing loops, which
+  //! advance from statement to statement
   ExecSchedule schedule;
-  //! How deeply nested within compound structures this position is
-  unsigned int nestLevel = 0;
 
-  //! Data spaces which are held invariant in the current context, grouped
-  //! by the loop that they are invariant in
-  std::vector<std::vector<std::string>> invariants;
+  //! Get how deeply nested within compound structures this position is
+  unsigned int getNestLevel() const;
 
   //! Get a string representing the iteration space
   std::string getIterSpaceString();
@@ -60,8 +84,25 @@ struct PositionContext {
   //! Get a string representing the given data access
   std::string getDataAccessString(DataAccess *);
 
+  // make* methods build the same sets and relations as the get*String
+  // methods describe, without IEGenLib having to parse a string. They return
+  // null when some expression is not affine in iterators, symbolic constants
+  // and uninterpreted function calls, in which case the string should be used.
+
+  //! Build the iteration space
+  std::unique_ptr<iegenlib::Set> makeIterSpace() const;
+
+  //! Build the execution schedule
+  std::unique_ptr<iegenlib::Relation> makeExecSchedule() const;
+
+  //! Build the relation for the given data access
+  std::unique_ptr<iegenlib::Relation> makeDataAccessRelation(const DataAccess &access);
+
   //! Check whether the given name is an iterator in this context
-  bool isIteratorName(const std::string &varName);
+  bool isIteratorName(llvm::StringRef varName) const;
+
+  //! Check whether the given data space is held invariant by an enclosing loop
+  bool isInvariant(llvm::StringRef dataSpaceName) const;
 
   // enter* and exit* methods add iterators and constraints when entering a
   // new scope, remove when leaving the scope
@@ -82,21 +123,102 @@ struct PositionContext {
   void exitIf();
 
 private:
+  /*!
+   * \struct Level
+   *
+   * \brief Everything a nest level fixes for the positions inside it,
+   * including what it inherits from enclosing levels
+   *
+   * Never modified once entered. Strings describing the level are built on
+   * entry, so that each statement only pays for what is particular to it.
+   */
+  struct Level {
+    //! Enclosing level, restored on exit
+    std::shared_ptr<const Level> parent;
+    //! How deeply nested within compound structures this level is
+    unsigned int nestLevel = 0;
+    //! Variables being iterated over
+    std::vector<std::string> iterators;
+    //! Iterators, for constant-time membership tests
+    SymbolSet iteratorSet;
+    //! Constraints on iteration -- inequalities and equalities
+    std::vector<Constraint> constraints;
+    //! Data spaces which are held invariant by enclosing loops
+    SymbolSet invariants;
+    //! Execution schedule values fixed by enclosing loops
+    ExecSchedule schedulePrefix;
+    //! Schedule of the enclosing level when this one was entered
+    ExecSchedule outerSchedule;
+    //! Tuple of iterators, like "[i,j,k]"
+    std::string itersTupleString;
+    //! Constraints, joined by " and "
+    std::string constraintsString;
+    //! Schedule prefix values, comma-separated, like "1,i,0,j"
+    std::string schedulePrefixString;
+    //! Iteration space, built on first use, or null if it cannot be built directly
+    mutable std::shared_ptr<const iegenlib::Set> iterSpace;
+    //! Whether iterSpace has been built yet
+    mutable bool iterSpaceBuilt = false;
+  };
+
+  //! BuildContext this position belongs to, source of unique replacement
+  //! names and of the symbol table
+  BuildContext *build;
+
+  //! Innermost level entered
+  std::shared_ptr<const Level> level;
+
+  //! Start a level nested in the current one, inheriting its contents
+  std::shared_ptr<Level> makeNestedLevel() const;
+
+  //! Make a nested level current, building its strings
+  //! \param[in] next Level to enter
+  void enterLevel(std::shared_ptr<Level> next);
+
+  //! Look up a name in the BuildContext's symbol table, without interning it
+  SymbolId lookupSymbol(llvm::StringRef name) const;
+
   //! Convenience function to add a new constraint from the given parameters
-  void makeAndInsertConstraint(Expr *lower, Expr *upper,
+  void makeAndInsertConstraint(Level &target, Expr *lower, Expr *upper,
                                BinaryOperatorKind oper);
 
   //! Convenience function to add a new constraint from the given parameters
-  void makeAndInsertConstraint(std::string lower, Expr *upper,
+  //! \param[in] target Level to add the constraint to
+  //! \param[in] lowerVar Variable on the left-hand side
+  //! \param[in] upper Right-hand side
+  //! \param[in] oper Comparison between the two sides
+  void makeAndInsertConstraint(Level &target, const std::string &lowerVar, Expr *upper,
                                BinaryOperatorKind oper);
 
+  //! Check and add a new constraint
+  void insertConstraint(Level &target, const Constraint &constraint);
+
+  //! Get a constraint as a string, like "0 <= i"
+  std::string constraintToString(const Constraint &constraint) const;
+
   //! Get the source code of an expression, with array accesses changed to
   //! function calls (for example, "i < A[i]" becomes "i < A(i)")
-  static std::string exprToStringWithSafeArrays(Expr *expr);
+  std::string exprToStringWithSafeArrays(Expr *expr) const;
+
+  //! Write one execution schedule value
+  void appendScheduleVal(std::ostream &os, const ScheduleVal &value) const;
+
+  //! Build the iteration space from scratch
+  std::unique_ptr<iegenlib::Set> buildIterSpace() const;
+
+  //! Get the position of an iterator in the tuple of iterators
+  //! \return The position, or -1 if the name is not an iterator
+  int getIteratorPosition(llvm::StringRef varName) const;
+
+  //! Convert an expression to an IEGenLib expression, with iterators as
+  //! tuple variables, other variables as symbolic constants and array
+  //! accesses as uninterpreted function calls
+  //! \return The expression, or null if it is not affine
+  std::unique_ptr<iegenlib::Exp> makeExp(Expr *expr) const;
 
-  //! Get the tuple of iterators as a string, for use in other to-string
-  //! methods. Output like "[i,j,k]"
-  std::string getItersTupleString();
+  //! Make an IEGenLib expression of just a variable: a tuple variable if it
+  //! is an iterator, otherwise a symbolic constant
+  std::unique_ptr<iegenlib::Exp> makeVarExp(llvm::StringRef name) const;
 };
 
 }  // namespace spf_ie
@@ -0,0 +1,71 @@
+/*!
+ * \file ResultCache.hpp
+ *
+ * \brief On-disk cache of translation results, addressed by the contents of
+ * what was translated.
+ */
+
+#ifndef SPFIE_RESULTCACHE_HPP
+#define SPFIE_RESULTCACHE_HPP
+
+#include <string>
+
+#include "FunctionIndex.hpp"
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/StringRef.h"
+
+//! Version of spf-ie, part of every cache key (along with the SPFIE_BUILD_ID
+//! of the sources built, generated into BuildId.hpp) so that results from
+//! other versions and builds are never reused
+#ifndef SPFIE_VERSION
+#define SPFIE_VERSION "unknown"
+#endif
+
+namespace spf_ie {
+
+/*!
+ * \class ResultCache
+ *
+ * \brief Directory of stored results (Computation IR or codegen), each in a
+ * file named by its key.
+ *
+ * A key is a hash of everything the result depends on: the function's source
+ * after preprocessing, the sources of every function it calls (transitively),
+ * the spf-ie version and build, and the settings used. A function which hasn't changed
+ * therefore maps to the same key across runs, while any change which could
+ * alter its result maps to a new one.
+ */
+class ResultCache {
+public:
+  //! \param[in] directory Directory to keep results in, created if absent
+  explicit ResultCache(std::string directory);
+
+  //! Compute the cache key for translating a function
+  //! \param[in] funcDecl Function to be translated
+  //! \param[in] settings Description of the settings affecting the result
+  //! \param[in] index Index to find the definitions of functions called
+  //! from other files in, if they may be inlined
+  //! \return Key, as a hex string
+  static std::string computeKey(const clang::FunctionDecl *funcDecl, llvm::StringRef settings,
+                                FunctionIndex *index = nullptr);
+
+  //! Look up a stored result
+  //! \param[in] key Key of the result
+  //! \param[out] result Stored result, if found
+  //! \return true if there was a stored result
+  bool lookup(const std::string &key, std::string &result) const;
+
+  //! Store a result, replacing any previous one with the same key.
+  //! Failure to store is reported but otherwise ignored.
+  void store(const std::string &key, const std::string &result) const;
+
+private:
+  std::string directory;
+
+  //! Get the path of the file holding the result with the given key
+  std::string getPath(const std::string &key) const;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,69 @@
+/*!
+ * \file SPFError.hpp
+ *
+ * \brief Errors for code which cannot be represented in SPF
+ */
+
+#ifndef SPFIE_SPFERROR_HPP
+#define SPFIE_SPFERROR_HPP
+
+#include <string>
+#include <system_error>
+
+#include "clang/AST/Stmt.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+/*!
+ * \class SPFError
+ *
+ * \brief A construct which could not be translated, with where it was found.
+ *
+ * Thrown while building a Computation, so that processing of the function
+ * is abandoned from however deep it has recursed, and returned as an
+ * llvm::Error from ComputationBuilder::buildComputationFromFunction.
+ */
+class SPFError : public llvm::ErrorInfo<SPFError> {
+public:
+  static char ID;
+
+  //! \param[in] message Description of what is wrong
+  //! \param[in] stmt Offending statement, if there is one
+  explicit SPFError(std::string message, const clang::Stmt *stmt = nullptr);
+
+  //! Print the message, followed by the location and source code of the
+  //! offending statement if known
+  void log(llvm::raw_ostream &os) const override;
+
+  std::error_code convertToErrorCode() const override;
+
+  //! Get the description of what is wrong
+  const std::string &getMessage() const { return message; }
+
+  //! Get the name of the file the offending statement is in, or an empty
+  //! string if it is not known
+  const std::string &getFileName() const { return fileName; }
+
+  //! Get the line of the offending statement, or 0 if it is not known
+  unsigned int getLine() const { return line; }
+
+  //! Get the column of the offending statement, or 0 if it is not known
+  unsigned int getColumn() const { return column; }
+
+  //! Get the source code of the offending statement, or an empty string
+  //! if it is not known
+  const std::string &getSourceCode() const { return sourceCode; }
+
+private:
+  std::string message;
+  std::string fileName;
+  unsigned int line = 0;
+  unsigned int column = 0;
+  std::string sourceCode;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,96 @@
+/*!
+ * \file SPFPrinter.hpp
+ *
+ * \brief Printing of statements and expressions as they should appear in
+ * SPF, in a single walk over the AST.
+ */
+
+#ifndef SPFIE_SPFPRINTER_HPP
+#define SPFIE_SPFPRINTER_HPP
+
+#include <map>
+#include <string>
+
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/StmtVisitor.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringRef.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+//! Text to be printed in place of function calls, such as the return
+//! values of inlined functions
+using CallReplacements = std::map<const CallExpr *, std::string>;
+
+/*!
+ * \class SPFPrinter
+ *
+ * \brief Prints the source code of a statement or expression, rewriting the
+ * parts which are written differently in SPF.
+ *
+ * Source text is copied between the rewritten nodes, so formatting is kept
+ * as written. Rewrites are made on the AST nodes themselves rather than by
+ * searching the printed text, so repeated or overlapping occurrences of the
+ * same text are each handled correctly.
+ */
+class SPFPrinter : public ConstStmtVisitor<SPFPrinter> {
+public:
+  //! Print the source code of a statement or expression
+  //! \param[in] stmt Statement or expression to print
+  //! \param[in] arraysAsCalls Whether to print array accesses as
+  //! uninterpreted function calls, as in A(i,j) for A[i][j]
+  //! \param[in] callReplacements Text to print in place of calls, if any
+  //! \param[out] result Printed source code
+  //! \return False if the source code could not be located, such as when
+  //! part of it comes from a macro expansion
+  static bool print(const clang::Stmt *stmt, bool arraysAsCalls,
+                    const CallReplacements *callReplacements,
+                    std::string &result);
+
+  void VisitStmt(const clang::Stmt *stmt);
+
+  void VisitArraySubscriptExpr(const ArraySubscriptExpr *expr);
+
+  void VisitCallExpr(const CallExpr *expr);
+
+private:
+  SPFPrinter(const SourceManager &sourceManager, const LangOptions &langOpts,
+             bool arraysAsCalls, const CallReplacements *callReplacements);
+
+  const SourceManager &sourceManager;
+  const LangOptions &langOpts;
+  bool arraysAsCalls;
+  const CallReplacements *callReplacements;
+
+  //! File the printed code is in
+  FileID file;
+  //! Contents of that file
+  llvm::StringRef buffer;
+  //! Offset in the buffer up to which source has been printed
+  unsigned cursor = 0;
+  //! Text printed so far
+  std::string out;
+  //! Whether the source code of some node could not be located
+  bool failed = false;
+
+  //! Get the offsets in the source buffer at which a node starts and ends
+  //! \return False if the node's source code could not be located
+  bool getOffsets(const clang::Stmt *node, unsigned &begin, unsigned &end);
+
+  //! Print source code up to an offset
+  void printUpTo(unsigned offset);
+
+  //! Print a node on its own, leaving the text printed so far untouched
+  std::string printSeparately(const clang::Stmt *node);
+
+  //! Print a node in place of the source between the offsets given
+  void replaceRange(unsigned begin, unsigned end, const std::string &text);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,91 @@
+/*!
+ * \file Server.hpp
+ *
+ * \brief Persistent server mode, which translates requests arriving on a
+ * local socket without paying process and library startup for each one.
+ */
+
+#ifndef SPFIE_SERVER_HPP
+#define SPFIE_SERVER_HPP
+
+#include <map>
+#include <string>
+
+#include "Driver.hpp"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+namespace spf_ie {
+
+/*!
+ * \class SPFServer
+ *
+ * \brief Accepts translation requests on a Unix socket, one per connection.
+ *
+ * A request is a block of "key: value" header lines ended by an empty line:
+ *  - source: path of the file to translate (required)
+ *  - entry-point: comma-separated functions to translate, or
+ *  - all-functions: true, to translate every function in the file
+ *  - mode: "codegen" (default), "ir", or "shutdown" to stop the server
+ *  - content-length: size in bytes of the file's contents, which follow the
+ *    empty line, to translate an in-memory buffer instead of the file on disk;
+ *    at most MaxContentLength
+ *
+ * The socket is only accessible to the user running the server, and is
+ * placed in a directory private to that user unless another path is given.
+ * The reply is a "status: ok" or "status: error" line and a "content-length"
+ * line, then an empty line, then the result (or error messages).
+ */
+class SPFServer {
+public:
+  //! Largest request headers accepted, in bytes
+  static const size_t MaxHeaderLength = 64 * 1024;
+  //! Largest file contents accepted in a request, in bytes
+  static const size_t MaxContentLength = 64 * 1024 * 1024;
+
+  //! Get the default socket path: spf-ie.sock in $XDG_RUNTIME_DIR, or if that
+  //! is unset, in a directory of /tmp named for the user, created on demand
+  static std::string getDefaultSocketPath();
+
+  //! \param[in] compilations Compilation database giving compile flags for requested files
+  //! \param[in] socketPath Path of the Unix socket to listen on, or empty for
+  //! the default
+  //! \param[in] defaults Settings for every request, other than those each request gives itself
+  SPFServer(const clang::tooling::CompilationDatabase &compilations, std::string socketPath,
+            TranslationRequest defaults);
+
+  //! Serve requests until asked to shut down
+  //! \return exit status for the process
+  int run();
+
+private:
+  const clang::tooling::CompilationDatabase &compilations;
+  std::string socketPath;
+  TranslationRequest defaults;
+  //! File system shared by all requests, which keeps the contents of files
+  //! (mostly headers) read for earlier requests while they are unchanged on disk
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fileSystem;
+
+  //! Make sure the socket can be created: create the default socket's
+  //! directory if need be, and remove a socket left at the path by an earlier
+  //! server. Anything else at the path is left alone.
+  //! \return false, after reporting why, if the socket cannot be created
+  bool prepareSocketPath();
+
+  //! Read, handle and reply to a request on a newly-accepted connection
+  //! \return false if the server was asked to shut down
+  bool handleConnection(int connection);
+
+  //! Translate the requested file
+  //! \param[in] headers Request header values, by key
+  //! \param[in] contents In-memory file contents, if provided
+  //! \param[out] response Result or error messages
+  //! \return true on success
+  bool translate(const std::map<std::string, std::string> &headers, const std::string *contents,
+                 std::string &response);
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,54 @@
+/*!
+ * \file SourceTextCache.hpp
+ *
+ * \brief Memoization of the source text of statements and expressions
+ */
+
+#ifndef SPFIE_SOURCETEXTCACHE_HPP
+#define SPFIE_SOURCETEXTCACHE_HPP
+
+#include "clang/AST/Stmt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace spf_ie {
+
+/*!
+ * \class SourceTextCache
+ *
+ * \brief Source text of the statements seen during one build, so that each
+ * is only looked up from the Lexer once.
+ *
+ * A cache is active on the thread that created it for as long as it exists,
+ * restoring the previously active one (if any) when destroyed. The text is
+ * referenced from the source buffers without copying, so a cache must not
+ * outlive the ASTs whose statements it holds.
+ */
+class SourceTextCache {
+public:
+  SourceTextCache();
+
+  ~SourceTextCache();
+
+  SourceTextCache(const SourceTextCache &) = delete;
+  SourceTextCache &operator=(const SourceTextCache &) = delete;
+
+  //! Get the source text of a statement, using the active cache on this
+  //! thread if there is one
+  static llvm::StringRef lookup(const clang::Stmt *stmt);
+
+private:
+  //! Cache in use on this thread
+  static thread_local SourceTextCache *active;
+
+  //! Cache which was active before this one
+  SourceTextCache *previous;
+
+  //! Text of each statement looked up so far. Keyed by node rather than by
+  //! Stmt::getID, which searches the AST allocator's slabs on every call.
+  llvm::DenseMap<const clang::Stmt *, llvm::StringRef> texts;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,124 @@
+/*!
+ * \file Stats.hpp
+ *
+ * \brief Process-wide wall time and call counts of spf-ie's phases, plus
+ * counters of the work done, for reporting with --stats.
+ */
+
+#ifndef SPFIE_STATS_HPP
+#define SPFIE_STATS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+/*!
+ * \class Stats
+ *
+ * \brief Totals of phase timings and counters, across all threads.
+ *
+ * Nothing is recorded unless enabled. A phase entered again while already
+ * running on the same thread (such as when building an inlined function)
+ * counts as another call, but its time is only counted once.
+ */
+class Stats {
+public:
+  Stats() = delete;
+
+  //! Phases of work which are timed
+  enum Phase {
+    //! Clang parsing of a translation unit
+    Parse,
+    //! Traversing function bodies and building Computations (includes the
+    //! phases below that it calls into)
+    ProcessBody,
+    //! Building iteration space, execution schedule and data access strings,
+    //! for those which cannot be built directly
+    PositionStrings,
+    //! Building iteration space, execution schedule and data access sets
+    //! and relations directly
+    PositionSets,
+    //! IEGenLib parsing set and relation strings when adding statements
+    IEGenLibParsing,
+    //! Computation::finalize()
+    Finalize,
+    //! Computation::codeGen()
+    CodeGen,
+    NumPhases
+  };
+
+  //! Counts of work done
+  enum Counter {
+    StmtsAdded,
+    DataAccessesRecorded,
+    FunctionsInlined,
+    CallsOutlined,
+    StmtsMerged,
+    DeclarationsFolded,
+    ConstraintsRemoved,
+    IslFallbacks,
+    ReplaceInStringCalls,
+    CacheHits,
+    CacheMisses,
+    StringFallbacks,
+    SourceTextHits,
+    SourceTextMisses,
+    ForeignFilesParsed,
+    SummaryHits,
+    SummaryMisses,
+    NumCounters
+  };
+
+  //! Start recording
+  static void enable();
+
+  //! Check whether recording is enabled
+  static bool isEnabled();
+
+  //! Add to a counter, if recording is enabled
+  static void increment(Counter counter, uint64_t amount = 1);
+
+  //! Record a completed call to a phase
+  //! \param[in] phase Phase that was called
+  //! \param[in] elapsed Wall time taken, or zero if already counted by an enclosing call
+  static void recordPhase(Phase phase, std::chrono::nanoseconds elapsed);
+
+  //! Print a human-readable report
+  static void print(llvm::raw_ostream &os);
+
+  //! Print the report as JSON
+  static void printJSON(llvm::raw_ostream &os);
+};
+
+/*!
+ * \class PhaseTimer
+ *
+ * \brief Times one call to a phase, from construction until stopped or destroyed.
+ */
+class PhaseTimer {
+public:
+  explicit PhaseTimer(Stats::Phase phase);
+
+  ~PhaseTimer();
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  //! Stop timing early, recording the call
+  void stop();
+
+private:
+  Stats::Phase phase;
+  //! Whether this timer is timing a call that has not yet been recorded
+  bool running;
+  //! Whether this is the outermost running call to the phase on this thread
+  bool outermost;
+  std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace spf_ie
+
+#endif
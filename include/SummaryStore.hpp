@@ -0,0 +1,81 @@
+/*!
+ * \file SummaryStore.hpp
+ *
+ * \brief On-disk store of the Computations built from called functions, for
+ * reuse across runs.
+ */
+
+#ifndef SPFIE_SUMMARYSTORE_HPP
+#define SPFIE_SUMMARYSTORE_HPP
+
+#include <string>
+
+#include "ResultCache.hpp"
+#include "clang/AST/Decl.h"
+#include "iegenlib.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+namespace spf_ie {
+
+/*!
+ * \class SummaryStore
+ *
+ * \brief Directory of summaries: the Computations built from called
+ * functions, serialized as JSON, to be appended in place of building the
+ * function again.
+ *
+ * A summary's key is a hash of the function's signature and source (see
+ * ResultCache::computeKey), so it can be computed wherever the function is
+ * seen, including when indexing other files with --cross-tu, combined with
+ * the build options which change the summary. Only functions
+ * which make no calls themselves are summarized: inlining renames variables
+ * with counters that a stored Computation would not advance, and whether a
+ * call is outlined depends on where the function is called from.
+ */
+class SummaryStore {
+public:
+  //! \param[in] directory Directory to keep summaries in, created if absent
+  explicit SummaryStore(std::string directory);
+
+  //! Compute the part of a function's summary key which depends only on the
+  //! function, not on how it is built
+  //! \param[in] funcDecl Definition of the function
+  //! \return Key, as a hex string
+  static std::string computeSourceKey(const clang::FunctionDecl *funcDecl);
+
+  //! Compute the key of a function's summary
+  //! \param[in] sourceKey Key computed with computeSourceKey
+  //! \param[in] settings Description of the build options which change the
+  //! summary (see BuildOptions::describeCalleeSettings)
+  //! \return Key, as a hex string
+  static std::string computeKey(const std::string &sourceKey, llvm::StringRef settings);
+
+  //! Load a stored summary
+  //! \param[in] key Key of the summary
+  //! \return The Computation, owned by the caller, or null if there is no
+  //! usable summary with that key
+  iegenlib::Computation *load(const std::string &key) const;
+
+  //! Store a summary, replacing any previous one with the same key.
+  //! Failure to store is reported but otherwise ignored.
+  //! \param[in] key Key of the summary
+  //! \param[in] computation Computation built from the function
+  void store(const std::string &key, const iegenlib::Computation *computation) const;
+
+  //! Serialize a Computation, which must not have been finalized, as JSON
+  static std::string serialize(const iegenlib::Computation *computation);
+
+  //! Rebuild a Computation serialized with serialize()
+  //! \return The Computation, owned by the caller, or an error if the
+  //! summary is malformed
+  static llvm::Expected<iegenlib::Computation *> deserialize(llvm::StringRef summary);
+
+private:
+  //! Files holding the summaries
+  ResultCache files;
+};
+
+}  // namespace spf_ie
+
+#endif
@@ -0,0 +1,93 @@
+/*!
+ * \file SymbolTable.hpp
+ *
+ * \brief Interning of variable names (iterators, data spaces and parameters)
+ * as integer IDs, and sets of those IDs
+ */
+
+#ifndef SPFIE_SYMBOLTABLE_HPP
+#define SPFIE_SYMBOLTABLE_HPP
+
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace spf_ie {
+
+//! Interned name
+using SymbolId = unsigned int;
+
+/*!
+ * \class SymbolTable
+ *
+ * \brief Maps names to dense integer IDs, so that they can be compared and
+ * looked up without handling strings.
+ */
+class SymbolTable {
+public:
+  //! ID returned by lookup for names which have not been interned
+  static const SymbolId NoSymbol = ~0u;
+
+  //! Get the ID of a name, interning it if necessary
+  SymbolId intern(llvm::StringRef name);
+
+  //! Get the ID of a name without interning it
+  //! \return The ID, or NoSymbol if the name has not been interned
+  SymbolId lookup(llvm::StringRef name) const;
+
+  //! Get the name an ID was interned from
+  llvm::StringRef getName(SymbolId id) const { return names[id]; }
+
+  //! Get the number of names interned
+  unsigned int size() const { return names.size(); }
+
+private:
+  //! ID of each interned name
+  llvm::StringMap<SymbolId> ids;
+  //! Name of each ID, referring to the keys of ids (which do not move)
+  std::vector<llvm::StringRef> names;
+};
+
+/*!
+ * \class SymbolSet
+ *
+ * \brief Multiset of symbols, with constant-time insertion, removal and
+ * membership tests.
+ *
+ * Counts how many times each symbol is in the set, so that a symbol inserted
+ * by several nested scopes stays in it until all of them remove it. Storage
+ * is proportional to the number of members, so small sets are cheap to copy.
+ */
+class SymbolSet {
+public:
+  //! Add a symbol to the set
+  void insert(SymbolId id) {
+    counts[id]++;
+  }
+
+  //! Remove one insertion of a symbol from the set
+  void erase(SymbolId id) {
+    if (id == SymbolTable::NoSymbol) {
+      return;
+    }
+    auto it = counts.find(id);
+    if (it != counts.end() && --it->second == 0) {
+      counts.erase(it);
+    }
+  }
+
+  //! Check whether a symbol is in the set
+  bool contains(SymbolId id) const {
+    return id != SymbolTable::NoSymbol && counts.count(id);
+  }
+
+private:
+  //! Number of times each symbol has been inserted and not removed
+  llvm::SmallDenseMap<SymbolId, unsigned int, 8> counts;
+};
+
+}  // namespace spf_ie
+
+#endif
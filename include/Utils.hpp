@@ -7,6 +7,7 @@
 #include "clang/AST/Expr.h"
 #include "clang/AST/OperationKinds.h"
 #include "clang/AST/Stmt.h"
+#include "llvm/ADT/StringRef.h"
 
 //! Base name (will be followed by a unique string) for use in variable
 //! substitutions
@@ -32,8 +33,14 @@ public:
   //! statement in the source code, and exit with error status
   static void printErrorAndExit(const std::string &message, clang::Stmt *stmt);
 
-  //! Get the source code of a statement as a string
-  static std::string stmtToString(clang::Stmt *stmt);
+  //! Abandon building the current Computation, throwing an SPFError
+  //! \param[in] message Description of what is wrong
+  //! \param[in] stmt Offending statement, if there is one
+  [[noreturn]] static void raiseError(const std::string &message, const clang::Stmt *stmt = nullptr);
+
+  //! Get the source code of a statement, which is looked up once per build
+  //! and not copied
+  static llvm::StringRef stmtToString(const clang::Stmt *stmt);
 
   //! Get a type as string, with any arrays replaced with pointers.
   //! For example, the type int[][] would become int**.
@@ -57,16 +64,9 @@ public:
   static void collectComponentsFromCompoundExpr(
       Expr *expr, std::vector<Expr *> &currentList, bool includeCallExprs = false);
 
-  //! Get a unique variable name to use in substitutions
-  static std::string getVarReplacementName();
-
 private:
   //! String representations of valid operators for use in constraints
   static const std::map<BinaryOperatorKind, std::string> operatorStrings;
-
-  //! Number to be used (and incremented) when creating replacement variable
-  //! names
-  static unsigned int replacementVarNumber;
 };
 
 }  // namespace spf_ie
@@ -0,0 +1,41 @@
+# Writes the ID of the sources being built to a header defining SPFIE_BUILD_ID,
+# for cache keys to change whenever spf-ie itself does. Run on every build as
+# cmake -DSOURCE_DIR=<source dir> -DOUTPUT=<header> -P WriteBuildId.cmake;
+# the header is only rewritten when the ID changes, so nothing is recompiled
+# otherwise.
+#
+# The ID is the commit from `git describe --always --dirty`, followed by a
+# hash of the uncommitted changes if there are any. Outside a git checkout it
+# is empty, and only the version tells builds apart.
+
+set(buildId "")
+find_package(Git QUIET)
+if(GIT_FOUND)
+  execute_process(COMMAND "${GIT_EXECUTABLE}" describe --always --dirty
+                  WORKING_DIRECTORY "${SOURCE_DIR}"
+                  RESULT_VARIABLE describeResult
+                  OUTPUT_VARIABLE describe
+                  OUTPUT_STRIP_TRAILING_WHITESPACE
+                  ERROR_QUIET)
+  if(describeResult EQUAL 0)
+    set(buildId "${describe}")
+    if(describe MATCHES "-dirty$")
+      # builds from different uncommitted changes are told apart too
+      execute_process(COMMAND "${GIT_EXECUTABLE}" diff HEAD
+                      WORKING_DIRECTORY "${SOURCE_DIR}"
+                      OUTPUT_VARIABLE diff
+                      ERROR_QUIET)
+      string(SHA1 diffHash "${diff}")
+      set(buildId "${buildId}-${diffHash}")
+    endif()
+  endif()
+endif()
+
+set(contents "#define SPFIE_BUILD_ID \"${buildId}\"\n")
+set(oldContents "")
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" oldContents)
+endif()
+if(NOT contents STREQUAL oldContents)
+  file(WRITE "${OUTPUT}" "${contents}")
+endif()
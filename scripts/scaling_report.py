@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Report how spf-ie's translation time scales along each synthetic kernel axis.
+
+Reads the JSON written by the benchmark suite (`make bench`), whose synthetic
+benchmarks are named <stage>/synthetic/<axis>:<value>, and prints, per axis
+and stage, the time at each value along with the growth exponent between
+consecutive values (1 is linear, 2 quadratic). Stages growing faster than
+--threshold are flagged. With --plot-dir, and matplotlib installed, also
+writes a log-log plot per axis.
+"""
+
+import argparse
+import json
+import math
+import re
+import sys
+from collections import defaultdict
+
+NAME_PATTERN = re.compile(r"^(?P<stage>[^/]+)/synthetic/(?P<axis>[a-z_]+):(?P<value>\d+)$")
+STAGES = ["BuildComputation", "Finalize", "CodeGen"]
+
+
+def load_series(path):
+    """Map axis -> stage -> sorted [(value, time in ns)]."""
+    with open(path) as f:
+        report = json.load(f)
+    series = defaultdict(lambda: defaultdict(list))
+    for bench in report.get("benchmarks", []):
+        if bench.get("run_type", "iteration") != "iteration":
+            continue
+        match = NAME_PATTERN.match(bench["name"])
+        if not match or match["stage"] not in STAGES:
+            continue
+        unit_ns = {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}[bench.get("time_unit", "ns")]
+        series[match["axis"]][match["stage"]].append(
+            (int(match["value"]), bench["real_time"] * unit_ns))
+    for stages in series.values():
+        for points in stages.values():
+            points.sort()
+    return series
+
+
+def growth_exponents(points):
+    """Log-log slope between each pair of consecutive points."""
+    exponents = []
+    for (x0, t0), (x1, t1) in zip(points, points[1:]):
+        if x0 > 0 and t0 > 0 and x1 != x0 and t1 > 0:
+            exponents.append(math.log(t1 / t0) / math.log(x1 / x0))
+    return exponents
+
+
+def print_report(series, threshold):
+    flagged = []
+    for axis in sorted(series):
+        print(f"== {axis} ==")
+        for stage in STAGES:
+            points = series[axis].get(stage)
+            if not points:
+                continue
+            exponents = growth_exponents(points)
+            times = "  ".join(f"{x}:{t / 1e6:.3f}ms" for x, t in points)
+            slopes = " ".join(f"{e:.2f}" for e in exponents)
+            print(f"  {stage:<17} {times}")
+            print(f"  {'':<17} growth exponents: {slopes}")
+            if exponents and exponents[-1] > threshold:
+                flagged.append((axis, stage, exponents[-1]))
+    if flagged:
+        print("\nSuper-linear scaling:")
+        for axis, stage, exponent in flagged:
+            print(f"  {stage} along {axis}: ~n^{exponent:.2f}")
+    return flagged
+
+
+def plot(series, plot_dir):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("matplotlib not available, skipping plots", file=sys.stderr)
+        return
+    for axis, stages in series.items():
+        fig, ax = plt.subplots()
+        for stage in STAGES:
+            if stage in stages:
+                xs, ts = zip(*stages[stage])
+                ax.plot(xs, [t / 1e6 for t in ts], marker="o", label=stage)
+        ax.set_xscale("log", base=2)
+        ax.set_yscale("log")
+        ax.set_xlabel(axis)
+        ax.set_ylabel("time (ms)")
+        ax.set_title(f"spf-ie scaling with {axis}")
+        ax.legend()
+        fig.savefig(f"{plot_dir}/scaling_{axis}.png", bbox_inches="tight")
+        plt.close(fig)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("bench_json", help="benchmark output, e.g. build/bench_output.json")
+    parser.add_argument("--threshold", type=float, default=1.3,
+                        help="growth exponent above which a stage is flagged (default 1.3)")
+    parser.add_argument("--plot-dir", help="directory to write per-axis plots to")
+    args = parser.parse_args()
+
+    series = load_series(args.bench_json)
+    if not series:
+        sys.exit(f"No synthetic benchmarks found in {args.bench_json}")
+    flagged = print_report(series, args.threshold)
+    if args.plot_dir:
+        plot(series, args.plot_dir)
+    sys.exit(1 if flagged else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+#include "BuildContext.hpp"
+
+#include <string>
+
+#include "Utils.hpp"
+#include "iegenlib.h"
+
+namespace spf_ie {
+
+/* BuildOptions */
+
+std::string BuildOptions::describe() const {
+  std::string description;
+  if (maxInlineDepth != Unlimited) {
+    description += ";max-inline-depth=" + std::to_string(maxInlineDepth);
+  }
+  if (inlineBudget != Unlimited) {
+    description += ";inline-budget=" + std::to_string(inlineBudget);
+  }
+  if (mergeStmts) {
+    description += ";merge-stmts";
+  }
+  if (foldDeclarations) {
+    description += ";fold-declarations";
+  }
+  if (simplifyConstraints) {
+    description += ";simplify-constraints";
+  }
+  return description;
+}
+
+std::string BuildOptions::describeCalleeSettings() const {
+  // the inlining limits only matter to callees making calls, which are
+  // never summarized, and constraints are simplified once they are inlined
+  std::string description;
+  if (mergeStmts) {
+    description += ";merge-stmts";
+  }
+  if (foldDeclarations) {
+    description += ";fold-declarations";
+  }
+  return description;
+}
+
+/* BuildContext */
+
+BuildContext::BuildContext() : positionContext(this) {}
+
+BuildContext::~BuildContext() {
+  for (const auto &it: subComputations) {
+    delete it.second;
+  }
+}
+
+std::string BuildContext::getVarReplacementName() {
+  return REPLACEMENT_VAR_BASE_NAME + std::to_string(replacementVarNumber++);
+}
+
+unsigned int BuildContext::restartVarReplacementNames(unsigned int next) {
+  unsigned int previous = replacementVarNumber;
+  replacementVarNumber = next;
+  return previous;
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,172 @@
+#include "CodeGen.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Stats.hpp"
+#include "iegenlib.h"
+#include "isl/ast.h"
+#include "isl/ast_build.h"
+#include "isl/ctx.h"
+#include "isl/map.h"
+#include "isl/options.h"
+#include "isl/printer.h"
+#include "isl/set.h"
+#include "isl/space.h"
+#include "isl/union_map.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+namespace {
+
+llvm::Error makeCodeGenError(const std::string &message) {
+  return llvm::make_error<llvm::StringError>(message, llvm::inconvertibleErrorCode());
+}
+
+//! Get the names to give a statement macro's parameters: the elements of
+//! its iteration space's tuple, with a placeholder for each constant one
+//! (for example, "i" and "j" for "{[i,j]: ...}", "__x0" for "{[0]}")
+std::vector<std::string> getMacroParams(const iegenlib::Set *iterationSpace) {
+  std::string printed = iterationSpace->prettyPrintString();
+  std::vector<std::string> params;
+  size_t begin = printed.find('[');
+  size_t end = printed.find(']', begin);
+  if (begin == std::string::npos || end == std::string::npos) {
+    return params;
+  }
+  std::istringstream tuple(printed.substr(begin + 1, end - begin - 1));
+  std::string elem;
+  while (std::getline(tuple, elem, ',')) {
+    elem.erase(0, elem.find_first_not_of(' '));
+    elem.erase(elem.find_last_not_of(' ') + 1);
+    if (elem.empty() || isdigit(static_cast<unsigned char>(elem[0])) || elem[0] == '-') {
+      elem = "__x" + std::to_string(params.size());
+    }
+    params.push_back(elem);
+  }
+  return params;
+}
+
+//! Read a statement's iteration space and execution schedule into isl, as
+//! a schedule map from the statement's named domain
+//! \return The map, or null if isl cannot represent them
+isl_map *makeStmtSchedule(isl_ctx *ctx, const iegenlib::Stmt *stmt, const std::string &name) {
+  std::string domainString;
+  std::string scheduleString;
+  try {
+    domainString = stmt->getIterationSpace()->toISLString();
+    scheduleString = stmt->getExecutionSchedule()->toISLString();
+  } catch (std::exception &) {
+    return nullptr;
+  }
+  isl_set *domain = isl_set_read_from_str(ctx, domainString.c_str());
+  isl_map *schedule = isl_map_read_from_str(ctx, scheduleString.c_str());
+  if (!domain || !schedule) {
+    isl_set_free(domain);
+    isl_map_free(schedule);
+    return nullptr;
+  }
+  domain = isl_set_set_tuple_name(domain, name.c_str());
+  schedule = isl_map_set_tuple_name(schedule, isl_dim_in, name.c_str());
+  // statements are ordered by the values of their schedules, not their names
+  schedule = isl_map_reset_tuple_id(schedule, isl_dim_out);
+  return isl_map_intersect_domain(schedule, domain);
+}
+
+}  // namespace
+
+/* CodeGen */
+
+std::string CodeGen::generate(iegenlib::Computation *computation, CodeGenBackend backend) {
+  if (backend == CodeGenBackend::Isl) {
+    auto code = generateWithIsl(computation);
+    if (code) {
+      return std::move(*code);
+    }
+    llvm::errs() << "WARNING: Generating code for '" << computation->getName()
+                 << "' with Omega instead of isl: " << llvm::toString(code.takeError()) << "\n";
+    Stats::increment(Stats::IslFallbacks);
+  }
+  return computation->codeGen();
+}
+
+llvm::Expected<std::string> CodeGen::generateWithIsl(iegenlib::Computation *computation) {
+  isl_ctx *ctx = isl_ctx_alloc();
+  // strings isl cannot parse make for a fallback, not an abort
+  isl_options_set_on_error(ctx, ISL_ON_ERROR_CONTINUE);
+
+  std::vector<isl_map *> stmtSchedules;
+  int scheduleDim = 0;
+  for (unsigned int i = 0; i < computation->getNumStmts(); ++i) {
+    isl_map *stmtSchedule = makeStmtSchedule(ctx, computation->getStmt(i), "s" + std::to_string(i));
+    if (!stmtSchedule) {
+      for (auto *it: stmtSchedules) {
+        isl_map_free(it);
+      }
+      isl_ctx_free(ctx);
+      return makeCodeGenError("isl cannot represent the iteration space or execution schedule of statement " +
+          std::to_string(i) + ", which may hold uninterpreted function calls");
+    }
+    scheduleDim = std::max(scheduleDim, (int) isl_map_dim(stmtSchedule, isl_dim_out));
+    stmtSchedules.push_back(stmtSchedule);
+  }
+
+  // schedules must all have the same number of dimensions, so shorter ones
+  // are padded with zeros, as Omega does
+  isl_union_map *schedule = isl_union_map_empty(isl_space_params_alloc(ctx, 0));
+  for (auto *stmtSchedule: stmtSchedules) {
+    int dim = isl_map_dim(stmtSchedule, isl_dim_out);
+    stmtSchedule = isl_map_add_dims(stmtSchedule, isl_dim_out, scheduleDim - dim);
+    for (int d = dim; d < scheduleDim; ++d) {
+      stmtSchedule = isl_map_fix_si(stmtSchedule, isl_dim_out, d, 0);
+    }
+    schedule = isl_union_map_add_map(schedule, stmtSchedule);
+  }
+
+  isl_ast_build *build = isl_ast_build_alloc(ctx);
+  isl_ast_node *tree = isl_ast_build_node_from_schedule_map(build, schedule);
+  isl_ast_build_free(build);
+  isl_printer *printer = isl_printer_to_str(ctx);
+  printer = isl_printer_set_output_format(printer, ISL_FORMAT_C);
+  printer = isl_printer_print_ast_node(printer, tree);
+  char *loops = isl_printer_get_str(printer);
+  bool generated = (loops != nullptr);
+  std::string loopCode = generated ? loops : "";
+  free(loops);
+  isl_printer_free(printer);
+  isl_ast_node_free(tree);
+  isl_ctx_free(ctx);
+  if (!generated) {
+    return makeCodeGenError("isl could not generate the loop nest");
+  }
+
+  // the loop nest calls each statement with the values of its iteration
+  // space's tuple
+  std::ostringstream code;
+  for (unsigned int i = 0; i < computation->getNumStmts(); ++i) {
+    const iegenlib::Stmt *stmt = computation->getStmt(i);
+    code << "#define s" << i << "(";
+    auto params = getMacroParams(stmt->getIterationSpace());
+    for (const auto &param: params) {
+      if (&param != &params.front()) {
+        code << ", ";
+      }
+      code << param;
+    }
+    code << ") " << stmt->getStmtSourceCode() << "\n";
+  }
+  code << "\n" << loopCode << "\n";
+  for (unsigned int i = 0; i < computation->getNumStmts(); ++i) {
+    code << "#undef s" << i << "\n";
+  }
+  return code.str();
+}
+
+}  // namespace spf_ie
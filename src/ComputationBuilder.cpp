@@ -1,6 +1,7 @@
 #include "ComputationBuilder.hpp"
 
 #include <algorithm>
+#include <exception>
 #include <map>
 #include <memory>
 #include <string>
@@ -8,33 +9,95 @@
 #include <utility>
 #include <vector>
 
+#include "ConstraintSimplifier.hpp"
+#include "Driver.hpp"
+#include "FunctionIndex.hpp"
+#include "SPFError.hpp"
+#include "SPFPrinter.hpp"
+#include "SummaryStore.hpp"
+#include "Stats.hpp"
 #include "Utils.hpp"
 #include "clang/AST/Decl.h"
 #include "clang/AST/Stmt.h"
+#include "clang/AST/Type.h"
 #include "iegenlib.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
 
 using namespace clang;
 
 namespace spf_ie {
 
-PositionContext *ComputationBuilder::positionContext;
-
 /* ComputationBuilder */
 
-std::map<std::string, Computation *> ComputationBuilder::subComputations;
 const std::unordered_set<std::string>
     ComputationBuilder::reservedFuncNames = {"sqrt", "ceil", "floor", "pow", "abs", "log", "log10"};
 
-ComputationBuilder::ComputationBuilder() = default;
+ComputationBuilder::ComputationBuilder(BuildContext &build)
+    : build(build), dataAccesses(&build.positionContext) {}
 
-iegenlib::Computation *
+llvm::Expected<iegenlib::Computation *>
 ComputationBuilder::buildComputationFromFunction(FunctionDecl *funcDecl) {
-  auto *funcBody = dyn_cast<CompoundStmt>(funcDecl->getBody());
+  build.inlineDepth = 0;
+  // replacement variables are numbered the same as when this function is
+  // the only one built from its translation unit
+  build.restartVarReplacementNames();
+  try {
+    Computation *computation = buildComputation(funcDecl);
+    if (build.options.simplifyConstraints) {
+      // inlined statements are simplified along with the rest, once
+      // they are in place
+      try {
+        ConstraintSimplifier::simplify(computation);
+      } catch (...) {
+        delete computation;
+        throw;
+      }
+    }
+    return computation;
+  } catch (SPFError &error) {
+    return llvm::make_error<SPFError>(std::move(error));
+  } catch (std::exception &exception) {
+    // such as IEGenLib rejecting a set or relation
+    return llvm::make_error<SPFError>(std::string("Could not build Computation: ") + exception.what());
+  }
+}
+
+llvm::Expected<FunctionScan> ComputationBuilder::scanFunction(FunctionDecl *funcDecl) {
+  try {
+    return scanOnly(funcDecl);
+  } catch (SPFError &error) {
+    return llvm::make_error<SPFError>(std::move(error));
+  }
+}
+
+CompoundStmt *ComputationBuilder::beginFunction(FunctionDecl *funcDecl) {
+  auto *funcBody = dyn_cast_or_null<CompoundStmt>(funcDecl->getBody());
   if (!funcBody) {
-    Utils::printErrorAndExit("Invalid function body", funcDecl->getBody());
+    Utils::raiseError("Invalid function body", funcDecl->getBody());
   }
+  build.positionContext = PositionContext(&build);
+  knownDataSpaces = SymbolSet();
+  return funcBody;
+}
+
+FunctionScan ComputationBuilder::scanOnly(FunctionDecl *funcDecl) {
+  llvm::TimeTraceScope timeScope("scanFunction", funcDecl->getNameAsString());
+  auto *funcBody = beginFunction(funcDecl);
+  scanning = true;
+  // parameters are data spaces, as they would be in the Computation
+  for (const auto *param: funcDecl->parameters()) {
+    knownDataSpaces.insert(build.symbols.intern(param->getName()));
+  }
+  PhaseTimer processBodyTimer(Stats::ProcessBody);
+  processBody(funcBody);
+  return scan;
+}
 
-  positionContext = new PositionContext();
+iegenlib::Computation *ComputationBuilder::buildComputation(FunctionDecl *funcDecl) {
+  llvm::TimeTraceScope timeScope("buildComputationFromFunction", funcDecl->getNameAsString());
+  auto *funcBody = beginFunction(funcDecl);
   computation = new iegenlib::Computation(funcDecl->getNameAsString());
 
   // add function parameters to the Computation
@@ -44,11 +107,21 @@ ComputationBuilder::buildComputationFromFunction(FunctionDecl *funcDecl) {
   }
 
   // collect function body info and add it to the Computation
-  processBody(funcBody);
+  PhaseTimer processBodyTimer(Stats::ProcessBody);
+  try {
+    processBody(funcBody);
+  } catch (...) {
+    delete computation;
+    computation = nullptr;
+    throw;
+  }
+  processBodyTimer.stop();
 
   // sanity check Computation completeness
   if (!computation->isComplete()) {
-    Utils::printErrorAndExit(
+    delete computation;
+    computation = nullptr;
+    Utils::raiseError(
         "Computation is in an inconsistent/incomplete state after "
         "building from function '" +
             funcDecl->getQualifiedNameAsString() +
@@ -75,40 +148,59 @@ void ComputationBuilder::processSingleStmt(clang::Stmt *stmt) {
       isa<SwitchStmt>(stmt) || isa<DoStmt>(stmt) || isa<LabelStmt>(stmt) ||
       isa<AttributedStmt>(stmt) || isa<GotoStmt>(stmt) ||
       isa<ContinueStmt>(stmt) || isa<BreakStmt>(stmt)) {
-    Utils::printErrorAndExit("Unsupported stmt type " +
-                                 std::string(stmt->getStmtClassName()),
-                             stmt);
+    Utils::raiseError("Unsupported stmt type " +
+                          std::string(stmt->getStmtClassName()),
+                      stmt);
   }
   // reset statement string replacement list
   stmtSourceCodeReplacements.clear();
-  this->dataAccesses = DataAccessHandler();
+  stmtHasOutlinedCall = false;
+  this->dataAccesses = DataAccessHandler(&build.positionContext);
 
   if (auto *asForStmt = dyn_cast<ForStmt>(stmt)) {
-    positionContext->schedule.advanceSchedule();
-    positionContext->enterFor(asForStmt);
+    build.positionContext.schedule.advanceSchedule();
+    build.positionContext.enterFor(asForStmt);
+    scan.numLoops++;
+    scan.maxLoopDepth = std::max(scan.maxLoopDepth, ++loopDepth);
+    macroStmt = nullptr;
     processBody(asForStmt->getBody());
-    positionContext->exitFor();
+    loopDepth--;
+    build.positionContext.exitFor();
+    // statements on either side of the loop are in different positions
+    macroStmt = nullptr;
   } else if (auto *asIfStmt = dyn_cast<IfStmt>(stmt)) {
     if (asIfStmt->getConditionVariable()) {
-      Utils::printErrorAndExit(
+      Utils::raiseError(
           "If statement condition variable declarations are unsupported",
           asIfStmt);
     }
-    positionContext->enterIf(asIfStmt);
+    build.positionContext.enterIf(asIfStmt);
+    scan.numIfs++;
+    macroStmt = nullptr;
     processBody(asIfStmt->getThen());
-    positionContext->exitIf();
+    build.positionContext.exitIf();
+    macroStmt = nullptr;
     // treat else clause (if present) as another if statement, but with
     // condition inverted
     if (asIfStmt->hasElseStorage()) {
-      positionContext->enterIf(asIfStmt, true);
+      build.positionContext.enterIf(asIfStmt, true);
+      scan.numIfs++;
       processBody(asIfStmt->getElse());
-      positionContext->exitIf();
+      build.positionContext.exitIf();
+      macroStmt = nullptr;
     }
   } else if (auto *asCallExpr = dyn_cast<CallExpr>(stmt)) {
-    positionContext->schedule.advanceSchedule();
+    build.positionContext.schedule.advanceSchedule();
     inlineFunctionCall(asCallExpr);
+    // an outlined call is a statement of its own
+    if (stmtHasOutlinedCall) {
+      addStmt(stmt);
+    }
   } else {
-    positionContext->schedule.advanceSchedule();
+    // folded declarations take up no position in the schedule
+    if (!isFoldedDeclaration(stmt)) {
+      build.positionContext.schedule.advanceSchedule();
+    }
 
     // gather data accesses
     std::map<std::string, std::string> functionCallValueReplacements;
@@ -117,8 +209,8 @@ void ComputationBuilder::processSingleStmt(clang::Stmt *stmt) {
         auto *varDecl = cast<VarDecl>(decl);
         std::string varName = varDecl->getNameAsString();
         // If this declaration's variable is already registered as a data space, this is another declaration by that name.
-        if (computation->isDataSpace(varName)) {
-          Utils::printErrorAndExit(
+        if (isDataSpace(varName)) {
+          Utils::raiseError(
               "Declaring a variable with a name that has already been used in another scope is disallowed",
               asDeclStmt);
         } else {
@@ -148,7 +240,7 @@ void ComputationBuilder::processSingleStmt(clang::Stmt *stmt) {
 void ComputationBuilder::addStmt(clang::Stmt *clangStmt) {
   // disallow statements following any return
   if (haveFoundAReturn) {
-    Utils::printErrorAndExit(
+    Utils::raiseError(
         "Found a statement following a return statement. Returns are only allowed at the end of functions.",
         clangStmt);
   }
@@ -158,78 +250,165 @@ void ComputationBuilder::addStmt(clang::Stmt *clangStmt) {
     return;
   }
 
-  // build IEGenLib Stmt and add it to the Computation
-  auto *newStmt = new iegenlib::Stmt();
+  llvm::TimeTraceScope timeScope("addStmt", [&]() { return Utils::stmtToString(clangStmt).str(); });
+
+  // enforce loop invariance
+  for (const auto &access: this->dataAccesses.stmtDataAccesses) {
+    if (!access.isRead && build.positionContext.isInvariant(access.name)) {
+      Utils::raiseError(
+          "Code may not modify loop-invariant data "
+          "space '" +
+              access.name + "'",
+          clangStmt);
+    }
+  }
+  scan.numStmts++;
+  if (scanning) {
+    addStmtDataSpaces(clangStmt);
+    return;
+  }
+  // a declaration without an initializer accesses nothing, so its variable
+  // only becomes a data space once some statement accesses it
+  if (isFoldedDeclaration(clangStmt)) {
+    Stats::increment(Stats::DeclarationsFolded);
+    return;
+  }
+
   // source code
-  std::string stmtSourceCode = Utils::stmtToString(clangStmt);
-  for (const auto &replacement: stmtSourceCodeReplacements) {
-    stmtSourceCode = iegenlib::replaceInString(stmtSourceCode, replacement.first, replacement.second);
+  std::string stmtSourceCode;
+  if (!SPFPrinter::print(clangStmt, false, &stmtSourceCodeReplacements, stmtSourceCode)) {
+    // the printer cannot place code from macros; substitute in the text instead
+    stmtSourceCode = Utils::stmtToString(clangStmt).str();
+    for (const auto &replacement: stmtSourceCodeReplacements) {
+      stmtSourceCode = iegenlib::replaceInString(
+          stmtSourceCode, Utils::stmtToString(replacement.first).str(), replacement.second);
+      Stats::increment(Stats::ReplaceInStringCalls);
+    }
   }
   // append semicolon if absent
   if (stmtSourceCode.back() != ';') {
     stmtSourceCode += ';';
   }
+
+  if (canMergeIntoMacroStmt()) {
+    // the macro statement's iteration space and schedule already fit
+    macroStmt->setStmtSourceCode(macroStmt->getStmtSourceCode() + " " + stmtSourceCode);
+    addStmtDataAccesses(macroStmt);
+    recordMacroStmtAccesses();
+    addStmtDataSpaces(clangStmt);
+    Stats::increment(Stats::StmtsMerged);
+    return;
+  }
+
+  // build IEGenLib Stmt and add it to the Computation
+  auto *newStmt = new iegenlib::Stmt();
   newStmt->setStmtSourceCode(stmtSourceCode);
-  // iteration space
-  std::string iterationSpace = positionContext->getIterSpaceString();
-  newStmt->setIterationSpace(iterationSpace);
-  // execution schedule
-  std::string executionSchedule = positionContext->getExecScheduleString();
-  newStmt->setExecutionSchedule(executionSchedule);
-  // data accesses
-  std::vector<std::pair<std::string, std::string>> dataReads;
-  std::vector<std::pair<std::string, std::string>> dataWrites;
+  // iteration space and execution schedule, built directly unless they
+  // cannot be, in which case IEGenLib parses them from strings
+  if (auto iterationSpace = build.positionContext.makeIterSpace()) {
+    newStmt->setIterationSpace(iterationSpace.release());
+  } else {
+    Stats::increment(Stats::StringFallbacks);
+    std::string iterationSpaceString = build.positionContext.getIterSpaceString();
+    PhaseTimer parseTimer(Stats::IEGenLibParsing);
+    newStmt->setIterationSpace(iterationSpaceString);
+  }
+  if (auto executionSchedule = build.positionContext.makeExecSchedule()) {
+    newStmt->setExecutionSchedule(executionSchedule.release());
+  } else {
+    Stats::increment(Stats::StringFallbacks);
+    std::string executionScheduleString = build.positionContext.getExecScheduleString();
+    PhaseTimer parseTimer(Stats::IEGenLibParsing);
+    newStmt->setExecutionSchedule(executionScheduleString);
+  }
+  addStmtDataAccesses(newStmt);
+
+  // add Computation data spaces
+  addStmtDataSpaces(clangStmt);
+
+  // insert the finished statement into the Computation
+  computation->addStmt(newStmt);
+  Stats::increment(Stats::StmtsAdded);
+
+  // an outlined call may touch more than its recorded accesses, so nothing
+  // is merged into its statement
+  macroStmt = nullptr;
+  if (build.options.mergeStmts && !stmtHasOutlinedCall) {
+    macroStmt = newStmt;
+    macroStmtReads.clear();
+    macroStmtWrites.clear();
+    recordMacroStmtAccesses();
+  }
+}
+
+void ComputationBuilder::recordMacroStmtAccesses() {
+  for (const auto &access: this->dataAccesses.stmtDataAccesses) {
+    (access.isRead ? macroStmtReads : macroStmtWrites).insert(access.name);
+  }
+}
+
+bool ComputationBuilder::isFoldedDeclaration(clang::Stmt *stmt) const {
+  auto *asDeclStmt = dyn_cast<DeclStmt>(stmt);
+  if (!build.options.foldDeclarations || !asDeclStmt) {
+    return false;
+  }
+  return std::none_of(asDeclStmt->decl_begin(), asDeclStmt->decl_end(), [](const Decl *decl) {
+    return cast<VarDecl>(decl)->hasInit();
+  });
+}
+
+bool ComputationBuilder::canMergeIntoMacroStmt() const {
+  // anything added since, such as an inlined call's statements, separates
+  // the two
+  if (!macroStmt || stmtHasOutlinedCall || computation->getNumStmts() == 0 ||
+      computation->getStmt(computation->getNumStmts() - 1) != macroStmt) {
+    return false;
+  }
+  for (const auto &access: this->dataAccesses.stmtDataAccesses) {
+    if (macroStmtWrites.count(access.name) || (!access.isRead && macroStmtReads.count(access.name))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ComputationBuilder::addStmtDataAccesses(iegenlib::Stmt *stmt) {
   for (auto &it_accesses: this->dataAccesses.stmtDataAccesses) {
     std::string dataSpaceAccessed = it_accesses.name;
-    // enforce loop invariance
-    if (!it_accesses.isRead) {
-      for (const auto &invariantGroup: positionContext->invariants) {
-        if (std::find(
-            invariantGroup.begin(), invariantGroup.end(),
-            dataSpaceAccessed) != invariantGroup.end()) {
-          Utils::printErrorAndExit(
-              "Code may not modify loop-invariant data "
-              "space '" +
-                  dataSpaceAccessed + "'",
-              clangStmt);
-        }
+    // insert data access
+    if (auto dataAccessRelation = build.positionContext.makeDataAccessRelation(it_accesses)) {
+      if (it_accesses.isRead) {
+        stmt->addRead(dataSpaceAccessed, dataAccessRelation.release());
+      } else {
+        stmt->addWrite(dataSpaceAccessed, dataAccessRelation.release());
       }
+      continue;
     }
-    // insert data access
+    Stats::increment(Stats::StringFallbacks);
+    std::string dataAccessString = build.positionContext.getDataAccessString(&it_accesses);
+    PhaseTimer parseTimer(Stats::IEGenLibParsing);
     if (it_accesses.isRead) {
-      newStmt->addRead(dataSpaceAccessed,
-                       positionContext->getDataAccessString(&it_accesses));
+      stmt->addRead(dataSpaceAccessed, dataAccessString);
     } else {
-      newStmt->addWrite(dataSpaceAccessed,
-                        positionContext->getDataAccessString(&it_accesses));
-    }
-  }
-
-  // add Computation data spaces
-  auto stmtDataSpaces = this->dataAccesses.dataSpacesAccessed;
-  for (const auto &dataSpaceName:
-      this->dataAccesses.dataSpacesAccessed) {
-    if (!computation->isDataSpace(dataSpaceName)) {
-      computation->addDataSpace(dataSpaceName,
-                                Utils::typeToArrayStrippedString(varDecls.at(dataSpaceName).getTypePtr()));
+      stmt->addWrite(dataSpaceAccessed, dataAccessString);
     }
   }
-
-  // insert the finished statement into the Computation
-  computation->addStmt(newStmt);
 }
 
 void ComputationBuilder::processReturnStmt(clang::ReturnStmt *returnStmt) {
   haveFoundAReturn = true;
-  if (positionContext->nestLevel != 0) {
-    Utils::printErrorAndExit("Return within nested structures is disallowed.", returnStmt);
+  if (build.positionContext.getNestLevel() != 0) {
+    Utils::raiseError("Return within nested structures is disallowed.", returnStmt);
   }
 
   if (auto *returnedValue = returnStmt->getRetValue()) {
     if (!Utils::isVarOrNumericLiteral(returnedValue)) {
-      Utils::printErrorAndExit("Return value is too complex, must be data space or number literal.", returnedValue);
+      Utils::raiseError("Return value is too complex, must be data space or number literal.", returnedValue);
+    }
+    scan.returnsValue = true;
+    if (!scanning) {
+      computation->addReturnValue(Utils::stmtToString(returnedValue).str());
     }
-    computation->addReturnValue(Utils::stmtToString(returnedValue));
   }
 }
 
@@ -237,9 +416,10 @@ std::string ComputationBuilder::inlineFunctionCall(CallExpr *callExpr) {
   // extract call
   auto *callee = callExpr->getDirectCallee();
   if (!callee) {
-    Utils::printErrorAndExit("Cannot processes this kind of call expression", callExpr);
+    Utils::raiseError("Cannot processes this kind of call expression", callExpr);
   }
   std::string calleeName = callee->getNameAsString();
+  llvm::TimeTraceScope timeScope("inlineFunctionCall", calleeName);
 
   // get arguments
   std::vector<clang::Expr *> callArgs;
@@ -247,19 +427,19 @@ std::string ComputationBuilder::inlineFunctionCall(CallExpr *callExpr) {
   for (unsigned int i = 0; i < callExpr->getNumArgs(); ++i) {
     auto *arg = callExpr->getArg(i)->IgnoreParenImpCasts();
     if (!Utils::isVarOrNumericLiteral(arg)) {
-      Utils::printErrorAndExit(
+      Utils::raiseError(
           "Argument passed to function is too complex (must be a data space or a numeric literal)",
           arg);
     }
     callArgs.emplace_back(arg);
-    callArgStrings.emplace_back(Utils::stmtToString(arg));
+    callArgStrings.emplace_back(Utils::stmtToString(arg).str());
   }
 
   // check if this is a reserved function, avoiding inlining if so
   if (reservedFuncNames.count(calleeName)) {
     // mark data space arguments as read
     for (unsigned int i = 0; i < callArgs.size(); ++i) {
-      if (computation->isDataSpace(callArgStrings[i])) {
+      if (isDataSpace(callArgStrings[i])) {
         this->dataAccesses.processExprAsRead(callArgs[i]);
       }
     }
@@ -267,38 +447,265 @@ std::string ComputationBuilder::inlineFunctionCall(CallExpr *callExpr) {
     return std::string();
   }
 
-  // find function definition and build Computation from it if necessary
-  auto *calleeDefinition = callee->getDefinition();
-  if (!calleeDefinition) {
-    Utils::printErrorAndExit("Cannot find definition for called function", callExpr);
+  // scanning checks everything that would be inlined without limits
+  if (scanning) {
+    scan.numCallsInlined++;
+    return scanFunctionCall(calleeName, findCalleeDefinition(callee, callExpr));
+  }
+
+  // outline calls nested too deeply, without building the callee
+  if (build.inlineDepth >= build.options.maxInlineDepth) {
+    return outlineFunctionCall(callExpr, callArgs, callArgStrings);
   }
-  if (!subComputations.count(calleeName)) {
-    // build Computation from calleeDefinition, if we haven't done so already
-    PositionContext oldContext = *positionContext;
-    auto builder = new ComputationBuilder();
-    subComputations[calleeName] = builder->buildComputationFromFunction(calleeDefinition);
-    *positionContext = oldContext;
-    delete builder;
+  // the callee's Computation depends on the depth it was built at, when that limits inlining
+  std::string subComputationKey = calleeName;
+  if (build.options.maxInlineDepth != BuildOptions::Unlimited) {
+    subComputationKey += "@" + std::to_string(build.inlineDepth);
   }
+  auto built = build.subComputations.find(subComputationKey);
+  // outline calls which would take this Computation over budget, judging a
+  // callee not built yet by its body, so that it is not built for nothing
+  auto exceedsBudget = [&](unsigned int calleeSize) {
+    return build.options.inlineBudget != BuildOptions::Unlimited &&
+        computation->getNumStmts() + calleeSize > build.options.inlineBudget;
+  };
+  if (exceedsBudget(built != build.subComputations.end() ?
+                    built->second->getNumStmts() : scanSubFunction(callee, callExpr))) {
+    return outlineFunctionCall(callExpr, callArgs, callArgStrings);
+  }
+  if (built == build.subComputations.end()) {
+    // get Computation for the callee, if we haven't done so already
+    built = build.subComputations.emplace(subComputationKey, buildSubComputation(callee, callExpr)).first;
+  }
+  Computation *subComputation = built->second;
+  // the callee may have inlined calls of its own, growing past its body
+  if (exceedsBudget(subComputation->getNumStmts())) {
+    return outlineFunctionCall(callExpr, callArgs, callArgStrings);
+  }
+  scan.numCallsInlined++;
 
-  auto appendResult = computation->appendComputation(subComputations[calleeName],
-                                                     positionContext->getIterSpaceString(),
-                                                     positionContext->getExecScheduleString(),
+  auto appendResult = computation->appendComputation(subComputation,
+                                                     build.positionContext.getIterSpaceString(),
+                                                     build.positionContext.getExecScheduleString(),
                                                      callArgStrings);
 
+  Stats::increment(Stats::FunctionsInlined);
+
   // move to the next schedule position immediately after the last one used by inlined statements
-  positionContext->schedule.skipToPosition(appendResult.tuplePosition);
-  positionContext->schedule.advanceSchedule();
+  build.positionContext.schedule.skipToPosition(appendResult.tuplePosition);
+  build.positionContext.schedule.advanceSchedule();
 
   // enforce no multiple return
   if (appendResult.returnValues.size() > 1) {
-    Utils::printErrorAndExit("Function call returned multiple values", callExpr);
+    Utils::raiseError("Function call returned multiple values", callExpr);
   }
 
   return (appendResult.returnValues.empty() ?
           std::string() : appendResult.returnValues.back());
 }
 
+std::string ComputationBuilder::outlineFunctionCall(CallExpr *callExpr, const std::vector<clang::Expr *> &callArgs,
+                                                    const std::vector<std::string> &callArgStrings) {
+  // the statement only records accesses to the call's arguments, so the
+  // callee is checked as inlining it would be, rejecting any other data
+  // space it accesses (such as a global)
+  scanSubFunction(callExpr->getDirectCallee(), callExpr);
+  // the call stays in the statement as written, reading its data space
+  // arguments and, for those passed by pointer, possibly reading and
+  // writing any of the elements they point to
+  for (unsigned int i = 0; i < callArgs.size(); ++i) {
+    if (!isDataSpace(callArgStrings[i])) {
+      continue;
+    }
+    unsigned int numDims = 0;
+    for (QualType type = callArgs[i]->getType();; ++numDims) {
+      if (const auto *asPointer = type->getAs<PointerType>()) {
+        type = asPointer->getPointeeType();
+      } else if (const auto *asArray = type->getAsArrayTypeUnsafe()) {
+        type = asArray->getElementType();
+      } else {
+        break;
+      }
+    }
+    if (numDims == 0) {
+      this->dataAccesses.processExprAsRead(callArgs[i]);
+    } else {
+      this->dataAccesses.processAccessToWholeArray(callArgStrings[i], numDims, true);
+      this->dataAccesses.processAccessToWholeArray(callArgStrings[i], numDims, false);
+    }
+  }
+  build.outlinedCalls[callExpr->getDirectCallee()->getNameAsString()].insert(
+      callExpr->getBeginLoc().printToString(Context->getSourceManager()));
+  numCallsOutlined++;
+  stmtHasOutlinedCall = true;
+  Stats::increment(Stats::CallsOutlined);
+  return std::string();
+}
+
+FunctionIndex::Definition ComputationBuilder::findCalleeDefinition(FunctionDecl *callee, CallExpr *callExpr) {
+  FunctionIndex::Definition calleeDefinition;
+  calleeDefinition.decl = callee->getDefinition();
+  calleeDefinition.context = Context;
+  // look in other files if need be
+  if (!calleeDefinition.decl && build.functionIndex) {
+    auto indexed = build.functionIndex->findDefinition(callee);
+    if (!indexed) {
+      Utils::raiseError(llvm::toString(indexed.takeError()), callExpr);
+    }
+    calleeDefinition = *indexed;
+  }
+  if (!calleeDefinition.decl) {
+    Utils::raiseError("Cannot find definition for called function", callExpr);
+  }
+  return calleeDefinition;
+}
+
+Computation *ComputationBuilder::buildSubComputation(FunctionDecl *callee, CallExpr *callExpr) {
+  // use a stored summary if there is one, for which the definition need not be parsed
+  std::string summaryKey;
+  if (build.summaries) {
+    std::string sourceKey;
+    if (const FunctionDecl *localDefinition = callee->getDefinition()) {
+      sourceKey = SummaryStore::computeSourceKey(localDefinition);
+    } else if (build.functionIndex) {
+      sourceKey = build.functionIndex->getSummarySourceKey(callee);
+    }
+    if (!sourceKey.empty()) {
+      // the callee is built with this run's options, which may change it
+      summaryKey = SummaryStore::computeKey(sourceKey, build.options.describeCalleeSettings());
+      if (Computation *summary = build.summaries->load(summaryKey)) {
+        Stats::increment(Stats::SummaryHits);
+        return summary;
+      }
+      Stats::increment(Stats::SummaryMisses);
+    }
+  }
+
+  FunctionIndex::Definition calleeDefinition = findCalleeDefinition(callee, callExpr);
+  // with summaries in use, callees are built on their own, so that the
+  // result is the same whichever caller they are first built for
+  std::unique_ptr<BuildContext> ownBuild;
+  if (build.summaries) {
+    ownBuild.reset(new BuildContext());
+    ownBuild->functionIndex = build.functionIndex;
+    ownBuild->summaries = build.summaries;
+    ownBuild->options = build.options;
+  }
+  BuildContext &calleeBuild = (ownBuild ? *ownBuild : build);
+  // saving the position is cheap, as its levels are shared rather than copied
+  PositionContext oldContext = build.positionContext;
+  unsigned int callerDepth = build.inlineDepth;
+  calleeBuild.inlineDepth = callerDepth + 1;
+  // replacement variables are bound within each access relation, so the
+  // callee numbers its own from zero, whether or not it was built before
+  unsigned int callerVarNumber = calleeBuild.restartVarReplacementNames();
+  ComputationBuilder builder(calleeBuild);
+  Computation *subComputation;
+  {
+    llvm::Optional<ForeignASTScope> foreignAST;
+    if (calleeDefinition.context != Context) {
+      foreignAST.emplace(*build.functionIndex, calleeDefinition);
+    }
+    subComputation = builder.buildComputation(calleeDefinition.decl);
+  }
+  build.positionContext = oldContext;
+  build.inlineDepth = callerDepth;
+  calleeBuild.restartVarReplacementNames(callerVarNumber);
+  if (ownBuild) {
+    for (const auto &it: ownBuild->outlinedCalls) {
+      build.outlinedCalls[it.first].insert(it.second.begin(), it.second.end());
+    }
+  }
+
+  // functions which make calls of their own are not summarized (see SummaryStore)
+  if (!summaryKey.empty() && builder.scan.numCallsInlined == 0 && builder.numCallsOutlined == 0) {
+    build.summaries->store(summaryKey, subComputation);
+  }
+  return subComputation;
+}
+
+unsigned int ComputationBuilder::scanSubFunction(FunctionDecl *callee, CallExpr *callExpr) {
+  std::string calleeName = callee->getNameAsString();
+  auto size = build.subFunctionSizes.find(calleeName);
+  if (size != build.subFunctionSizes.end()) {
+    return size->second;
+  }
+  FunctionIndex::Definition calleeDefinition = findCalleeDefinition(callee, callExpr);
+  PositionContext oldContext = build.positionContext;
+  // scanning hands out replacement names for the callee's own calls
+  unsigned int callerVarNumber = build.restartVarReplacementNames();
+  ComputationBuilder builder(build);
+  unsigned int numStmts;
+  {
+    llvm::Optional<ForeignASTScope> foreignAST;
+    if (calleeDefinition.context != Context) {
+      foreignAST.emplace(*build.functionIndex, calleeDefinition);
+    }
+    numStmts = builder.scanOnly(calleeDefinition.decl).numStmts;
+  }
+  build.positionContext = oldContext;
+  build.restartVarReplacementNames(callerVarNumber);
+  build.subFunctionSizes.emplace(calleeName, numStmts);
+  return numStmts;
+}
+
+std::string ComputationBuilder::scanFunctionCall(const std::string &calleeName,
+                                                 const FunctionIndex::Definition &calleeDefinition) {
+  auto scanned = build.scannedSubFunctions.find(calleeName);
+  if (scanned == build.scannedSubFunctions.end()) {
+    PositionContext oldContext = build.positionContext;
+    ComputationBuilder builder(build);
+    bool returnsValue;
+    {
+      llvm::Optional<ForeignASTScope> foreignAST;
+      if (calleeDefinition.context != Context) {
+        foreignAST.emplace(*build.functionIndex, calleeDefinition);
+      }
+      returnsValue = builder.scanOnly(calleeDefinition.decl).returnsValue;
+    }
+    scanned = build.scannedSubFunctions.emplace(calleeName, returnsValue).first;
+    build.positionContext = oldContext;
+  }
+  build.positionContext.schedule.advanceSchedule();
+  if (!scanned->second) {
+    return std::string();
+  }
+  // stand in for the renamed return value inlining would produce, which is a data space
+  std::string returnValue = build.getVarReplacementName();
+  knownDataSpaces.insert(build.symbols.intern(returnValue));
+  return returnValue;
+}
+
+bool ComputationBuilder::isDataSpace(const std::string &name) {
+  SymbolId symbol = build.symbols.intern(name);
+  if (knownDataSpaces.contains(symbol)) {
+    return true;
+  }
+  // data spaces are never removed, so only positive answers are remembered
+  if (computation && computation->isDataSpace(name)) {
+    knownDataSpaces.insert(symbol);
+    return true;
+  }
+  return false;
+}
+
+void ComputationBuilder::addStmtDataSpaces(clang::Stmt *stmt) {
+  for (const auto &dataSpaceName: this->dataAccesses.dataSpacesAccessed) {
+    if (isDataSpace(dataSpaceName)) {
+      continue;
+    }
+    auto varDecl = varDecls.find(dataSpaceName);
+    if (varDecl == varDecls.end()) {
+      Utils::raiseError("Data space '" + dataSpaceName + "' is not declared in the function", stmt);
+    }
+    if (!scanning) {
+      computation->addDataSpace(dataSpaceName,
+                                Utils::typeToArrayStrippedString(varDecl->second.getTypePtr()));
+    }
+    knownDataSpaces.insert(build.symbols.intern(dataSpaceName));
+  }
+}
+
 void ComputationBuilder::processComplexExpr(Expr *expr, bool processReads) {
   std::vector<Expr *> components;
   Utils::collectComponentsFromCompoundExpr(expr, components, true);
@@ -307,7 +714,7 @@ void ComputationBuilder::processComplexExpr(Expr *expr, bool processReads) {
       if (isa<ArraySubscriptExpr>(component)) {
         this->dataAccesses.processExprAsRead(component);
       } else if (auto *asDeclRefExpr = dyn_cast<DeclRefExpr>(component)) {
-        if (!ComputationBuilder::positionContext->isIteratorName(asDeclRefExpr->getDecl()->getNameAsString())) {
+        if (!build.positionContext.isIteratorName(asDeclRefExpr->getDecl()->getName())) {
           this->dataAccesses.processExprAsRead(component);
         }
       }
@@ -315,7 +722,7 @@ void ComputationBuilder::processComplexExpr(Expr *expr, bool processReads) {
     if (auto *asCallExpr = dyn_cast<CallExpr>(component)) {
       std::string returnValue = inlineFunctionCall(asCallExpr);
       if (!returnValue.empty()) {
-        this->stmtSourceCodeReplacements.emplace(Utils::stmtToString(asCallExpr), returnValue);
+        this->stmtSourceCodeReplacements.emplace(asCallExpr, returnValue);
         if (processReads) {
           this->dataAccesses.processReadToScalarName(returnValue);
         }
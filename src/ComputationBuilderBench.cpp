@@ -0,0 +1,195 @@
+/*!
+ * \file ComputationBuilderBench.cpp
+ *
+ * \brief Benchmarks timing each stage of translation (AST building,
+ * Computation building, finalize and codegen) over the kernels in the test
+ * folder and over synthetic kernels of varying shape.
+ */
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BuildContext.hpp"
+#include "ComputationBuilder.hpp"
+#include "Driver.hpp"
+#include "KernelGenerator.hpp"
+#include "Utils.hpp"
+#include "benchmark/benchmark.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "iegenlib.h"
+
+//! Directory holding the kernels in the test folder
+#ifndef SPFIE_TEST_KERNEL_DIR
+#define SPFIE_TEST_KERNEL_DIR "test"
+#endif
+
+using namespace clang;
+using namespace spf_ie;
+
+thread_local const ASTContext *spf_ie::Context;
+
+namespace {
+
+/*!
+ * \struct Kernel
+ *
+ * \brief Source code of a kernel to benchmark, and the function in it to translate
+ */
+struct Kernel {
+  std::string name;
+  std::string code;
+  std::string entryPoint;
+};
+
+//! Read a kernel from the test folder
+Kernel readTestKernel(const std::string &fileName, const std::string &entryPoint) {
+  std::ifstream file(std::string(SPFIE_TEST_KERNEL_DIR) + "/" + fileName);
+  if (!file) {
+    Utils::printErrorAndExit("Could not read benchmark kernel '" + fileName + "'");
+  }
+  std::ostringstream code;
+  code << file.rdbuf();
+  return {fileName, code.str(), entryPoint};
+}
+
+//! Make a synthetic kernel of the given shape
+Kernel makeSyntheticKernel(const KernelShape &shape) {
+  return {"synthetic", KernelGenerator::generate(shape, "synthetic"), "synthetic"};
+}
+
+//! Parse kernel code into an AST, setting the global ASTContext to it
+std::unique_ptr<ASTUnit> buildAST(const Kernel &kernel) {
+  std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(kernel.code, "kernel.c");
+  Context = &AST->getASTContext();
+  return AST;
+}
+
+//! Find the kernel's entry point in its AST
+FunctionDecl *findEntryPoint(const Kernel &kernel) {
+  for (auto it: Context->getTranslationUnitDecl()->decls()) {
+    auto *func = dyn_cast<FunctionDecl>(it);
+    if (func && func->doesThisDeclarationHaveABody() &&
+        kernel.entryPoint == func->getQualifiedNameAsString()) {
+      return func;
+    }
+  }
+  Utils::printErrorAndExit("Could not find function '" + kernel.entryPoint + "' in benchmark kernel");
+  return nullptr;
+}
+
+//! Build a Computation from a function, as the driver does
+iegenlib::Computation *buildComputation(FunctionDecl *func) {
+  iegenlib::Computation::resetNumRenamesCounters();
+  BuildContext build;
+  ComputationBuilder builder(build);
+  auto computation = builder.buildComputationFromFunction(func);
+  if (!computation) {
+    Utils::printErrorAndExit(llvm::toString(computation.takeError()));
+  }
+  return *computation;
+}
+
+void BM_BuildAST(benchmark::State &state, const Kernel &kernel) {
+  for (auto _: state) {
+    benchmark::DoNotOptimize(buildAST(kernel));
+  }
+}
+
+void BM_BuildComputation(benchmark::State &state, const Kernel &kernel) {
+  auto AST = buildAST(kernel);
+  FunctionDecl *func = findEntryPoint(kernel);
+  for (auto _: state) {
+    iegenlib::Computation *computation = buildComputation(func);
+    state.PauseTiming();
+    delete computation;
+    state.ResumeTiming();
+  }
+}
+
+void BM_Finalize(benchmark::State &state, const Kernel &kernel) {
+  auto AST = buildAST(kernel);
+  FunctionDecl *func = findEntryPoint(kernel);
+  for (auto _: state) {
+    state.PauseTiming();
+    iegenlib::Computation *computation = buildComputation(func);
+    state.ResumeTiming();
+    computation->finalize();
+    state.PauseTiming();
+    delete computation;
+    state.ResumeTiming();
+  }
+}
+
+void BM_CodeGen(benchmark::State &state, const Kernel &kernel) {
+  auto AST = buildAST(kernel);
+  FunctionDecl *func = findEntryPoint(kernel);
+  for (auto _: state) {
+    state.PauseTiming();
+    iegenlib::Computation *computation = buildComputation(func);
+    computation->finalize();
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(computation->codeGen());
+    state.PauseTiming();
+    delete computation;
+    state.ResumeTiming();
+  }
+}
+
+//! Register a benchmark of every stage for the kernel
+void registerStages(const std::string &name, const Kernel &kernel) {
+  benchmark::RegisterBenchmark(("BuildAST/" + name).c_str(), BM_BuildAST, kernel);
+  benchmark::RegisterBenchmark(("BuildComputation/" + name).c_str(), BM_BuildComputation, kernel);
+  benchmark::RegisterBenchmark(("Finalize/" + name).c_str(), BM_Finalize, kernel);
+  benchmark::RegisterBenchmark(("CodeGen/" + name).c_str(), BM_CodeGen, kernel);
+}
+
+}  // namespace
+
+//! Register and run benchmarks
+int main(int argc, char **argv) {
+  const std::vector<Kernel> testKernels = {
+      readTestKernel("csr_spmv.c", "CSR_SpMV"),
+      readTestKernel("forward_solve.c", "forward_solve"),
+      readTestKernel("matrix_add.c", "matrix_add"),
+      readTestKernel("nesting_test.c", "main"),
+  };
+  for (const auto &kernel: testKernels) {
+    registerStages(kernel.name, kernel);
+  }
+
+  // synthetic kernels, scaling one axis at a time away from a small base shape
+  KernelShape base;
+  base.loopDepth = 2;
+  base.numStmts = 4;
+  const std::vector<std::pair<std::string, unsigned int KernelShape::*>> axes = {
+      {"stmts", &KernelShape::numStmts},
+      {"depth", &KernelShape::loopDepth},
+      {"ifs", &KernelShape::numIfGuards},
+      {"calls", &KernelShape::callFanOut},
+      {"inline_depth", &KernelShape::inliningDepth},
+      {"array_dim", &KernelShape::arrayDim},
+  };
+  const std::vector<unsigned int> axisValues = {1, 2, 4, 8, 16};
+  for (const auto &axis: axes) {
+    for (unsigned int value: axisValues) {
+      KernelShape shape = base;
+      shape.*axis.second = value;
+      // inlining depth only matters when there are calls to inline
+      if (axis.second == &KernelShape::inliningDepth) {
+        shape.callFanOut = 1;
+      }
+      registerStages("synthetic/" + axis.first + ":" + std::to_string(value), makeSyntheticKernel(shape));
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -9,27 +9,39 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <regex>
 #include <string>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "Driver.hpp"
+#include "CodeGen.hpp"
 #include "ComputationBuilder.hpp"
+#include "ConstraintSimplifier.hpp"
+#include "DataAccessHandler.hpp"
+#include "FunctionIndex.hpp"
+#include "SPFError.hpp"
+#include "SummaryStore.hpp"
 #include "Utils.hpp"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
 #include "gtest/gtest.h"
 #include "iegenlib.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace clang;
 using namespace spf_ie;
 
-const ASTContext *spf_ie::Context;
+thread_local const ASTContext *spf_ie::Context;
 
 /*!
  * \class ComputationBuilderTest
@@ -44,30 +56,99 @@ protected:
   virtual void SetUp() override {
     iegenlib::Computation::resetNumRenamesCounters();
   }
-  virtual void TearDown() override {
-    ComputationBuilder::subComputations.clear();
-  }
 
   const std::string replacementVarName = REPLACEMENT_VAR_BASE_NAME;
 
-  //! Build a Computation from the first function in the provided code string.
-  static iegenlib::Computation *
-  buildComputationFromCode(const std::string &code, const std::string &entryPoint) {
-    std::unique_ptr<ASTUnit> AST = tooling::buildASTFromCode(
-        code, "test_input.cpp", std::make_shared<PCHContainerOperations>());
+  //! AST of the code most recently built from, kept until the next code is
+  //! parsed so that its functions can be looked up after building
+  std::unique_ptr<ASTUnit> AST;
+  //! Code AST was parsed from
+  std::string parsedCode;
+
+  //! Parse the provided code string, unless it was the last parsed, and make
+  //! its AST the current one
+  void parseCode(const std::string &code) {
+    if (!AST || code != parsedCode) {
+      AST = tooling::buildASTFromCode(code, "test_input.cpp", std::make_shared<PCHContainerOperations>());
+      parsedCode = code;
+    }
     Context = &AST->getASTContext();
+  }
 
-    ComputationBuilder builder;
-    Computation *comp;
-    bool builtComputation = false;
+  //! Build a Computation from the named function in the provided code string,
+  //! or get the error preventing it.
+  //! \param[in] options Settings to build with
+  //! \param[in,out] build Context to build in, so that it can be given a
+  //! function index or summaries beforehand and inspected afterward, or null
+  //! to use a fresh one. Must only be reused with the same code, which is
+  //! then parsed only once.
+  llvm::Expected<iegenlib::Computation *>
+  tryBuildComputationFromCode(const std::string &code, const std::string &entryPoint,
+                              const BuildOptions &options = {}, BuildContext *build = nullptr) {
+    parseCode(code);
+    std::unique_ptr<BuildContext> ownBuild;
+    if (!build) {
+      ownBuild.reset(new BuildContext());
+      build = ownBuild.get();
+    }
+    build->options = options;
+    ComputationBuilder builder(*build);
+    return builder.buildComputationFromFunction(findFunction(code, entryPoint));
+  }
+
+  //! Scan the named function in the provided code string.
+  llvm::Expected<FunctionScan>
+  scanFunctionFromCode(const std::string &code, const std::string &entryPoint) {
+    parseCode(code);
+    BuildContext build;
+    ComputationBuilder builder(build);
+    return builder.scanFunction(findFunction(code, entryPoint));
+  }
+
+  //! Find the definition of the named function in the current AST
+  static FunctionDecl *findFunction(const std::string &code, const std::string &entryPoint) {
     for (auto it: Context->getTranslationUnitDecl()->decls()) {
       auto *func = dyn_cast<FunctionDecl>(it);
       if (func && func->doesThisDeclarationHaveABody() &&
           entryPoint == func->getQualifiedNameAsString()) {
-        return builder.buildComputationFromFunction(func);
+        return func;
       }
     }
     Utils::printErrorAndExit("No Computation could be generated from the following provided code:\n" + code);
+    return nullptr;
+  }
+
+  //! Build a Computation from the named function in the provided code string
+  //! (see tryBuildComputationFromCode).
+  iegenlib::Computation *
+  buildComputationFromCode(const std::string &code, const std::string &entryPoint,
+                           const BuildOptions &options = {}, BuildContext *build = nullptr) {
+    auto computation = tryBuildComputationFromCode(code, entryPoint, options, build);
+    if (!computation) {
+      Utils::printErrorAndExit(llvm::toString(computation.takeError()));
+    }
+    return *computation;
+  }
+
+  //! EXPECT with gTest that building a Computation from the named function
+  //! fails, with an error message containing the given text.
+  void expectBuildError(const std::string &code, const std::string &entryPoint,
+                        const std::string &expectedMessage, const BuildOptions &options = {}) {
+    auto computation = tryBuildComputationFromCode(code, entryPoint, options);
+    if (computation) {
+      delete *computation;
+      ADD_FAILURE() << "Expected building '" << entryPoint << "' to fail with: " << expectedMessage;
+      return;
+    }
+    std::string message;
+    llvm::handleAllErrors(computation.takeError(), [&](const SPFError &error) {
+      message = error.getMessage();
+      EXPECT_GT(error.getLine(), 0u) << "Error has no source location: " << message;
+    }, [&](const llvm::ErrorInfoBase &error) {
+      message = error.message();
+    });
+    EXPECT_NE(std::string::npos, message.find(expectedMessage))
+        << "Error message '" << message << "' does not contain '" << expectedMessage << "'";
   }
 
   //! EXPECT with gTest that two Computations are equal, component by component.
@@ -138,7 +219,7 @@ protected:
   }
 };
 
-using ComputationBuilderDeathTest = ComputationBuilderTest;
+using ComputationBuilderErrorTest = ComputationBuilderTest;
 
 //! Test that the matrix add Computation is built up as expected
 TEST_F(ComputationBuilderTest, matrix_add_correct) {
@@ -273,6 +354,113 @@ int CSR_SpMV(int a, int N, int A[a], int index[N + 1], int col[a], int x[N], int
   expectComputationsEqual(computation, expectedComputation);
 }
 
+//! Test that affine index expressions and array conditions come out the same
+//! as IEGenLib would parse them from strings
+TEST_F(ComputationBuilderTest, affine_indexes_correct) {
+  std::string code =
+      "void strided(int n, double a[n], double b[n]) {\
+    int i;\
+    for (i = 1; i < n; i++) {\
+        if (b[i] > 0) {\
+            a[2 * i + 1] = b[i - 1];\
+        }\
+    }\
+}";
+
+  iegenlib::Computation *computation = buildComputationFromCode(code, "strided");
+
+  Computation *expectedComputation = new Computation("strided");
+  expectedComputation->addParameter("n", "int");
+  expectedComputation->addParameter("a", "double*");
+  expectedComputation->addParameter("b", "double*");
+
+  expectedComputation->addStmt(new iegenlib::Stmt("int i;", "{[0]}", "{[0]->[0]}", {}, {}));
+  expectedComputation->addStmt(new iegenlib::Stmt("a[2 * i + 1] = b[i - 1];",
+                                                  "{[i]: 1 <= i && i < n && b(i) > 0}",
+                                                  "{[i]->[1,i,0]}",
+                                                  {{"b", "{[i]->[" + replacementVarName + "1]: " +
+                                                      replacementVarName + "1 = i - 1}"}},
+                                                  {{"a", "{[i]->[" + replacementVarName + "0]: " +
+                                                      replacementVarName + "0 = 2 * i + 1}"}}));
+
+  expectComputationsEqual(computation, expectedComputation);
+}
+
+//! Test that array accesses nested in, and textually overlapping, other
+//! accesses are each written as UF calls
+TEST_F(ComputationBuilderTest, nested_array_conditions_correct) {
+  std::string code =
+      "void nested(int n, int a[n], int b[n], int ab[n]) {\
+    int i;\
+    for (i = 0; i < n; i++) {\
+        if (a[b[i]] > ab[b[i]]) {\
+            a[i] = 0;\
+        }\
+    }\
+}";
+
+  iegenlib::Computation *computation = buildComputationFromCode(code, "nested");
+
+  Computation *expectedComputation = new Computation("nested");
+  expectedComputation->addParameter("n", "int");
+  expectedComputation->addParameter("a", "int*");
+  expectedComputation->addParameter("b", "int*");
+  expectedComputation->addParameter("ab", "int*");
+
+  expectedComputation->addStmt(new iegenlib::Stmt("int i;", "{[0]}", "{[0]->[0]}", {}, {}));
+  expectedComputation->addStmt(new iegenlib::Stmt("a[i] = 0;",
+                                                  "{[i]: 0 <= i && i < n && a(b(i)) > ab(b(i))}",
+                                                  "{[i]->[1,i,0]}",
+                                                  {},
+                                                  {{"a", "{[i]->[i]}"}}));
+
+  expectComputationsEqual(computation, expectedComputation);
+}
+
+//! Test that a nested access and its sub-access point at each other, both
+//! when first made and once added to a statement's accesses
+TEST_F(ComputationBuilderTest, nested_access_graph_linked) {
+  std::string code =
+      "void gather(int k, int *x, int *col, int *y) {\
+    y[k] = x[col[k]];\
+}";
+
+  parseCode(code);
+  auto *body = cast<CompoundStmt>(findFunction(code, "gather")->getBody());
+  auto *assignment = cast<BinaryOperator>(body->body_front());
+  Expr *written = assignment->getLHS()->IgnoreParenImpCasts();
+  Expr *read = assignment->getRHS()->IgnoreParenImpCasts();
+
+  BuildContext build;
+  // sub-accesses come first, so x[col[k]] is made as col (0), then x (1)
+  auto accesses = DataAccessHandler::makeDataAccessesFromExpr(read, true, build.positionContext);
+  ASSERT_EQ(2u, accesses.size());
+  EXPECT_EQ("col", accesses[0].name);
+  EXPECT_EQ(1u, accesses[0].enclosingAccess);
+  EXPECT_EQ(std::vector<DataAccessId>{DataAccess::NoAccess}, accesses[0].subaccesses);
+  EXPECT_EQ("x", accesses[1].name);
+  EXPECT_EQ(DataAccess::NoAccess, accesses[1].enclosingAccess);
+  EXPECT_EQ(std::vector<DataAccessId>{0u}, accesses[1].subaccesses);
+  EXPECT_EQ(&accesses[0], accesses[1].getSubaccess(0, accesses));
+
+  // once stored after the write to y (0), the edges use the statement's IDs
+  DataAccessHandler handler(&build.positionContext);
+  handler.processExprAsWrite(written);
+  handler.processExprAsRead(read);
+  const auto &stmtAccesses = handler.stmtDataAccesses;
+  ASSERT_EQ(3u, stmtAccesses.size());
+  EXPECT_EQ("y", stmtAccesses[0].name);
+  EXPECT_EQ(DataAccess::NoAccess, stmtAccesses[0].enclosingAccess);
+  EXPECT_EQ(std::vector<DataAccessId>{DataAccess::NoAccess}, stmtAccesses[0].subaccesses);
+  EXPECT_EQ("col", stmtAccesses[1].name);
+  EXPECT_EQ(2u, stmtAccesses[1].enclosingAccess);
+  EXPECT_EQ(std::vector<DataAccessId>{DataAccess::NoAccess}, stmtAccesses[1].subaccesses);
+  EXPECT_EQ("x", stmtAccesses[2].name);
+  EXPECT_EQ(DataAccess::NoAccess, stmtAccesses[2].enclosingAccess);
+  EXPECT_EQ(std::vector<DataAccessId>{1u}, stmtAccesses[2].subaccesses);
+  EXPECT_EQ(&stmtAccesses[1], stmtAccesses[2].getSubaccess(0, stmtAccesses));
+}
+
 TEST_F(ComputationBuilderTest, reserved_function_call) {
   std::string code = "\
 #include <math.h>\
@@ -399,9 +587,477 @@ TEST_F(ComputationBuilderTest, nesting_with_args_and_return) {
 }
 
 
-/** Death tests, checking failure on invalid input **/
+//! Test that scanning counts a function's contents without building it,
+//! and rejects what building would
+TEST_F(ComputationBuilderTest, scan_counts_shape) {
+  std::string code = \
+"int inner(int, int);\n"
+"\n"
+"int outer(int n, int A[n][n]) {\n"
+"  int a = 0;\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    for (int j = 0; j < n; j++) {\n"
+"      if (A[i][j] > 0) {\n"
+"        a += inner(i, 3);\n"
+"      } else {\n"
+"        a -= 1;\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"  return a;\n"
+"}\n"
+"\n"
+"int inner(int x, int y) {\n"
+"  x*=y;\n"
+"  return x;\n"
+"}";
+
+  auto shape = scanFunctionFromCode(code, "outer");
+  ASSERT_TRUE((bool) shape) << llvm::toString(shape.takeError());
+  EXPECT_EQ(3u, shape->numStmts);
+  EXPECT_EQ(2u, shape->numLoops);
+  EXPECT_EQ(2u, shape->maxLoopDepth);
+  EXPECT_EQ(2u, shape->numIfs);
+  EXPECT_EQ(1u, shape->numCallsInlined);
+  EXPECT_TRUE(shape->returnsValue);
+
+  std::string rejected =
+      "int a() {\
+    int x = 0;\
+    for (int i = 0; i < 5; i += 2) {\
+        x = i;\
+    }\
+    return x;\
+}";
+  auto rejectedShape = scanFunctionFromCode(rejected, "a");
+  ASSERT_FALSE((bool) rejectedShape);
+  std::string message = llvm::toString(rejectedShape.takeError());
+  EXPECT_NE(std::string::npos, message.find("Invalid increment in for loop -- must increase iterator by 1"));
+}
+
+//! Test that a call to a function defined in another file is inlined
+//! through the function index, the same as if it were defined in this one
+TEST_F(ComputationBuilderTest, cross_file_call_inlined) {
+  std::string callerCode = \
+"int inner(int, int);\n"
+"\n"
+"int outer(int n) {\n"
+"  int a = 0;\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a += inner(i, 3);\n"
+"  }\n"
+"  return a;\n"
+"}\n";
+  std::string calleeCode = \
+"int inner(int x, int y) {\n"
+"  x*=y;\n"
+"  return x;\n"
+"}\n";
+
+  int fd;
+  llvm::SmallString<128> calleePath;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("spfie_callee", "cpp", fd, calleePath));
+  {
+    llvm::raw_fd_ostream calleeFile(fd, true);
+    calleeFile << calleeCode;
+  }
+  tooling::FixedCompilationDatabase compilations(".", {});
+  FunctionIndex index(compilations);
+  EXPECT_EQ(0, index.build({calleePath.str().str()}));
+  EXPECT_EQ(1u, index.size());
+
+  BuildContext build;
+  build.functionIndex = &index;
+  auto computation = tryBuildComputationFromCode(callerCode, "outer", {}, &build);
+  llvm::sys::fs::remove(calleePath);
+  ASSERT_TRUE((bool) computation) << llvm::toString(computation.takeError());
+
+  iegenlib::Computation::resetNumRenamesCounters();
+  Computation *expectedComputation = buildComputationFromCode(callerCode + calleeCode, "outer");
+
+  expectComputationsEqual(*computation, expectedComputation);
+}
 
-TEST_F(ComputationBuilderDeathTest, for_incorrect_initializer_fails) {
+//! Test that a called function's summary is stored, and that building
+//! again with it gives the same Computation
+TEST_F(ComputationBuilderTest, summaries_reused) {
+  std::string code = \
+"int inner(int x, int y) {\n"
+"  x*=y;\n"
+"  return x;\n"
+"}\n"
+"\n"
+"int outer(int n) {\n"
+"  int a = 0;\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a += inner(i, 3);\n"
+"  }\n"
+"  return a;\n"
+"}\n";
+
+  llvm::SmallString<128> summaryDir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("spfie_summaries", summaryDir));
+  SummaryStore summaries(summaryDir.str().str());
+
+  std::vector<Computation *> computations;
+  for (int run = 0; run < 2; ++run) {
+    iegenlib::Computation::resetNumRenamesCounters();
+    BuildContext build;
+    build.summaries = &summaries;
+    computations.push_back(buildComputationFromCode(code, "outer", {}, &build));
+  }
+  Computation *summary = summaries.load(SummaryStore::computeSourceKey(findFunction(code, "inner")));
+  llvm::sys::fs::remove_directories(summaryDir);
+  ASSERT_NE(nullptr, summary);
+
+  expectComputationsEqual(computations[1], computations[0]);
+
+  auto roundTripped = SummaryStore::deserialize(SummaryStore::serialize(summary));
+  ASSERT_TRUE((bool) roundTripped) << llvm::toString(roundTripped.takeError());
+  expectComputationsEqual(*roundTripped, summary);
+}
+
+//! Test that a summary built with options changing the called function is
+//! not used by a build without them
+TEST_F(ComputationBuilderTest, summaries_keyed_by_options) {
+  std::string code = \
+"int inner(int x, int y) {\n"
+"  int s = x;\n"
+"  int t = y;\n"
+"  s += t;\n"
+"  return s;\n"
+"}\n"
+"\n"
+"int outer(int n) {\n"
+"  int a = 0;\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a += inner(i, 3);\n"
+"  }\n"
+"  return a;\n"
+"}\n";
+
+  llvm::SmallString<128> summaryDir;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("spfie_summaries", summaryDir));
+  SummaryStore summaries(summaryDir.str().str());
+
+  BuildOptions merging;
+  merging.mergeStmts = true;
+  {
+    BuildContext build;
+    build.summaries = &summaries;
+    delete buildComputationFromCode(code, "outer", merging, &build);
+  }
+  std::string sourceKey = SummaryStore::computeSourceKey(findFunction(code, "inner"));
+  std::unique_ptr<Computation> merged(
+      summaries.load(SummaryStore::computeKey(sourceKey, merging.describeCalleeSettings())));
+  ASSERT_NE(nullptr, merged.get());
+  EXPECT_EQ(2u, merged->getNumStmts());
+  EXPECT_EQ(nullptr, summaries.load(SummaryStore::computeKey(sourceKey, BuildOptions().describeCalleeSettings())));
+  // folding declarations changes the statements and schedules too
+  BuildOptions folding;
+  folding.foldDeclarations = true;
+  EXPECT_NE(SummaryStore::computeKey(sourceKey, BuildOptions().describeCalleeSettings()),
+            SummaryStore::computeKey(sourceKey, folding.describeCalleeSettings()));
+  EXPECT_NE(SummaryStore::computeKey(sourceKey, merging.describeCalleeSettings()),
+            SummaryStore::computeKey(sourceKey, folding.describeCalleeSettings()));
+
+  // building without merging misses the merged summary
+  iegenlib::Computation::resetNumRenamesCounters();
+  BuildContext build;
+  build.summaries = &summaries;
+  Computation *computation = buildComputationFromCode(code, "outer", {}, &build);
+  iegenlib::Computation::resetNumRenamesCounters();
+  Computation *expectedComputation = buildComputationFromCode(code, "outer");
+  llvm::sys::fs::remove_directories(summaryDir);
+
+  expectComputationsEqual(computation, expectedComputation);
+  delete computation;
+  delete expectedComputation;
+}
+
+//! Test that calls beyond the inlining limits are left in place, with
+//! their call sites recorded
+TEST_F(ComputationBuilderTest, calls_outlined_beyond_limits) {
+  std::string code = \
+"int inner(int x, int y) {\n"
+"  x*=y;\n"
+"  return x;\n"
+"}\n"
+"\n"
+"int outer(int n) {\n"
+"  int a = n;\n"
+"  a += inner(a, 2);\n"
+"  a += inner(a, 3);\n"
+"  return a;\n"
+"}\n";
+
+  // the first call fits within the budget, but the second would not
+  {
+    BuildOptions options;
+    options.inlineBudget = 2;
+    BuildContext build;
+    Computation *computation = buildComputationFromCode(code, "outer", options, &build);
+    ASSERT_EQ(4u, computation->getNumStmts());
+    EXPECT_EQ(std::string::npos, computation->getStmt(2)->getStmtSourceCode().find("inner("));
+    EXPECT_EQ("a += inner(a, 3);", computation->getStmt(3)->getStmtSourceCode());
+    EXPECT_EQ(1u, build.outlinedCalls["inner"].size());
+  }
+
+  // no calls are inlined at all
+  {
+    iegenlib::Computation::resetNumRenamesCounters();
+    BuildOptions options;
+    options.maxInlineDepth = 0;
+    BuildContext build;
+    Computation *computation = buildComputationFromCode(code, "outer", options, &build);
+    ASSERT_EQ(3u, computation->getNumStmts());
+    EXPECT_EQ("a += inner(a, 2);", computation->getStmt(1)->getStmtSourceCode());
+    EXPECT_EQ(2u, build.outlinedCalls["inner"].size());
+    EXPECT_TRUE(build.subComputations.empty());
+  }
+
+  // neither call fits, which is seen from the callee's body before building it
+  {
+    iegenlib::Computation::resetNumRenamesCounters();
+    BuildOptions options;
+    options.inlineBudget = 1;
+    BuildContext build;
+    Computation *computation = buildComputationFromCode(code, "outer", options, &build);
+    ASSERT_EQ(3u, computation->getNumStmts());
+    EXPECT_EQ(2u, build.outlinedCalls["inner"].size());
+    EXPECT_TRUE(build.subComputations.empty());
+    EXPECT_EQ(1u, build.subFunctionSizes["inner"]);
+  }
+}
+
+//! Test that an outlined call is taken to read and write every element of
+//! an array passed to it
+TEST_F(ComputationBuilderTest, outlined_call_accesses_whole_array) {
+  std::string code = \
+"void fill(int n, double *a) {\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a[i] = 0;\n"
+"  }\n"
+"}\n"
+"\n"
+"void caller(int n, double *a) {\n"
+"  fill(n, a);\n"
+"}\n";
+
+  BuildOptions options;
+  options.maxInlineDepth = 0;
+  Computation *computation = buildComputationFromCode(code, "caller", options);
+  ASSERT_EQ(1u, computation->getNumStmts());
+
+  auto *expectedStmt = new iegenlib::Stmt("fill(n, a);", "{[0]}", "{[0]->[0]}",
+                                          {{"n", "{[0]->[0]}"},
+                                           {"a", "{[0]->[" + replacementVarName + "0]}"}},
+                                          {{"a", "{[0]->[" + replacementVarName + "1]}"}});
+  expectStmtsEqual(computation->getStmt(0), expectedStmt);
+  delete expectedStmt;
+  delete computation;
+}
+
+//! Test that functions built one after another from the same translation
+//! unit come out the same as when each is built on its own
+TEST_F(ComputationBuilderTest, functions_built_independently) {
+  std::string code = \
+"void shift(int n, double a[n], double b[n]) {\n"
+"  for (int i = 1; i < n; i++) {\n"
+"    a[i - 1] = b[i + 1];\n"
+"  }\n"
+"}\n"
+"\n"
+"void stride(int n, double a[n], double b[n]) {\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a[2 * i] = b[2 * i + 1];\n"
+"  }\n"
+"}\n";
+
+  BuildContext sharedBuild;
+  for (const std::string &funcName: {"shift", "stride"}) {
+    SCOPED_TRACE("Function '" + funcName + "'");
+    iegenlib::Computation::resetNumRenamesCounters();
+    Computation *inBatch = buildComputationFromCode(code, funcName, {}, &sharedBuild);
+    iegenlib::Computation::resetNumRenamesCounters();
+    Computation *alone = buildComputationFromCode(code, funcName);
+
+    expectComputationsEqual(inBatch, alone);
+    delete inBatch;
+    delete alone;
+  }
+}
+
+//! Test that independent statements in the same position are merged, and
+//! dependent ones kept apart
+TEST_F(ComputationBuilderTest, independent_stmts_merged) {
+  std::string code = \
+"void merge(int n, int a[n], int b[n]) {\n"
+"  int x = 1;\n"
+"  int y = 2;\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a[i] = x;\n"
+"    b[i] = y;\n"
+"    a[i] += b[i];\n"
+"  }\n"
+"}\n";
+
+  BuildOptions options;
+  options.mergeStmts = true;
+  Computation *computation = buildComputationFromCode(code, "merge", options);
+
+  auto *expectedComputation = new Computation("merge");
+  expectedComputation->addParameter("n", "int");
+  expectedComputation->addParameter("a", "int*");
+  expectedComputation->addParameter("b", "int*");
+  expectedComputation->addDataSpace("x", "int");
+  expectedComputation->addDataSpace("y", "int");
+  expectedComputation->addStmt(new iegenlib::Stmt("int x = 1; int y = 2;", "{[0]}", "{[0]->[0]}", {},
+                                                  {{"x", "{[0]->[0]}"}, {"y", "{[0]->[0]}"}}));
+  expectedComputation->addStmt(new iegenlib::Stmt(
+      "a[i] = x; b[i] = y;", "{[i]: 0<=i<n}", "{[i]->[2,i,0]}", {{"x", "{[i]->[0]}"}, {"y", "{[i]->[0]}"}},
+      {{"a", "{[i]->[i]}"}, {"b", "{[i]->[i]}"}}));
+  expectedComputation->addStmt(new iegenlib::Stmt(
+      "a[i] += b[i];", "{[i]: 0<=i<n}", "{[i]->[2,i,2]}", {{"a", "{[i]->[i]}"}, {"b", "{[i]->[i]}"}},
+      {{"a", "{[i]->[i]}"}}));
+
+  expectComputationsEqual(computation, expectedComputation);
+  delete expectedComputation;
+}
+
+//! Test that a statement reading what an earlier statement merged into the
+//! same macro statement writes starts a new one, even when it conflicts
+//! with no other statement in the run
+TEST_F(ComputationBuilderTest, merged_stmt_accesses_accumulate) {
+  std::string code = \
+"void chain(int n, int a[n], int b[n], int c[n], int x, int y) {\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    a[i] = x;\n"
+"    b[i] = y;\n"
+"    c[i] = b[i];\n"
+"  }\n"
+"}\n";
+
+  BuildOptions options;
+  options.mergeStmts = true;
+  Computation *computation = buildComputationFromCode(code, "chain", options);
+  ASSERT_EQ(2u, computation->getNumStmts());
+  EXPECT_EQ("a[i] = x; b[i] = y;", computation->getStmt(0)->getStmtSourceCode());
+  EXPECT_EQ("c[i] = b[i];", computation->getStmt(1)->getStmtSourceCode());
+  delete computation;
+}
+
+//! Test that declarations without initializers are left out, with
+//! following statements keeping their order
+TEST_F(ComputationBuilderTest, declarations_folded) {
+  std::string code = \
+"int fold(int n, int a[n]) {\n"
+"  int i;\n"
+"  int t;\n"
+"  int s = 0;\n"
+"  for (i = 0; i < n; i++) {\n"
+"    t = a[i];\n"
+"    s += t;\n"
+"  }\n"
+"  return s;\n"
+"}\n";
+
+  BuildOptions options;
+  options.foldDeclarations = true;
+  Computation *computation = buildComputationFromCode(code, "fold", options);
+
+  auto *expectedComputation = new Computation("fold");
+  expectedComputation->addParameter("n", "int");
+  expectedComputation->addParameter("a", "int*");
+  expectedComputation->addDataSpace("s", "int");
+  expectedComputation->addDataSpace("t", "int");
+  expectedComputation->addStmt(new iegenlib::Stmt("int s = 0;", "{[0]}", "{[0]->[0]}", {}, {{"s", "{[0]->[0]}"}}));
+  expectedComputation->addStmt(new iegenlib::Stmt(
+      "t = a[i];", "{[i]: 0<=i<n}", "{[i]->[1,i,0]}", {{"a", "{[i]->[i]}"}}, {{"t", "{[i]->[0]}"}}));
+  expectedComputation->addStmt(new iegenlib::Stmt(
+      "s += t;", "{[i]: 0<=i<n}", "{[i]->[1,i,1]}", {{"s", "{[i]->[0]}"}, {"t", "{[i]->[0]}"}},
+      {{"s", "{[i]->[0]}"}}));
+  expectedComputation->addReturnValue("s", true);
+
+  expectComputationsEqual(computation, expectedComputation);
+  delete expectedComputation;
+}
+
+//! Test that if conditions repeating or loosening the loop bounds are
+//! removed from iteration spaces
+TEST_F(ComputationBuilderTest, redundant_constraints_removed) {
+  std::string code = \
+"void bounded(int n, int a[n]) {\n"
+"  for (int i = 0; i < n - 1; i++) {\n"
+"    if (i >= 0) {\n"
+"      if (i < n) {\n"
+"        a[i] = 0;\n"
+"      }\n"
+"    }\n"
+"  }\n"
+"}\n";
+
+  BuildOptions options;
+  options.simplifyConstraints = true;
+  Computation *computation = buildComputationFromCode(code, "bounded", options);
+  ASSERT_EQ(1u, computation->getNumStmts());
+
+  iegenlib::Set expected("{[i]: 0 <= i && i < n - 1}");
+  EXPECT_EQ(expected.prettyPrintString(), computation->getStmt(0)->getIterationSpace()->prettyPrintString());
+
+  // simplifying again finds nothing more to remove
+  EXPECT_EQ(0u, ConstraintSimplifier::simplify(computation));
+  delete computation;
+}
+
+//! Test that isl generates the loop nest of an affine Computation, and
+//! refuses one with uninterpreted function calls
+TEST_F(ComputationBuilderTest, isl_codegen) {
+  std::string affineCode = \
+"void scale(int n, int a[n], int b[n]) {\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    b[i] = a[i] * 2;\n"
+"  }\n"
+"}\n";
+  Computation *affine = buildComputationFromCode(affineCode, "scale");
+  affine->finalize();
+  auto affineResult = CodeGen::generateWithIsl(affine);
+  ASSERT_TRUE((bool) affineResult) << llvm::toString(affineResult.takeError());
+  EXPECT_NE(std::string::npos, affineResult->find("#define s0(i) "));
+  // isl names its own iterators and may write bounds in several ways, so
+  // only the shape is checked: one loop, bounded by n, calling s0 with its
+  // iterator
+  size_t loopPos = affineResult->find("for (");
+  ASSERT_NE(std::string::npos, loopPos) << *affineResult;
+  EXPECT_EQ(std::string::npos, affineResult->find("for (", loopPos + 1)) << *affineResult;
+  size_t headerEnd = affineResult->find(')', loopPos);
+  ASSERT_NE(std::string::npos, headerEnd) << *affineResult;
+  std::string header = affineResult->substr(loopPos, headerEnd - loopPos + 1);
+  std::smatch iterator;
+  ASSERT_TRUE(std::regex_search(header, iterator, std::regex(R"(for \(int (\w+) =)"))) << header;
+  EXPECT_TRUE(std::regex_search(header, std::regex(R"(;[^;]*\bn\b[^;]*;)"))) << header;
+  EXPECT_NE(std::string::npos, affineResult->find("s0(" + iterator[1].str() + ")", headerEnd)) << *affineResult;
+  delete affine;
+
+  std::string sparseCode = \
+"void gather(int n, int index[n], int a[n], int b[n]) {\n"
+"  for (int i = 0; i < n; i++) {\n"
+"    if (index[i] >= 0) {\n"
+"      b[i] = a[i];\n"
+"    }\n"
+"  }\n"
+"}\n";
+  Computation *sparse = buildComputationFromCode(sparseCode, "gather");
+  sparse->finalize();
+  auto sparseResult = CodeGen::generateWithIsl(sparse);
+  EXPECT_FALSE((bool) sparseResult);
+  llvm::consumeError(sparseResult.takeError());
+  delete sparse;
+}
+
+/** Error tests, checking failure on invalid input **/
+
+TEST_F(ComputationBuilderErrorTest, for_incorrect_initializer_fails) {
   std::string code1 =
       "int a() {\
     int x;\
@@ -410,8 +1066,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_initializer_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code1, "a"), "Invalid initializer in for loop -- must initialize just one variable");
+  expectBuildError(code1, "a",
+                   "Invalid initializer in for loop -- must initialize just one variable");
 
   std::string code2 =
       "int a() {\
@@ -422,9 +1078,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_initializer_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code2, "a"),
-      "Invalid initializer in for loop -- must be present");
+  expectBuildError(code2, "a",
+                   "Invalid initializer in for loop -- must be present");
 
   std::string code3 =
       "int a() {\
@@ -435,12 +1090,11 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_initializer_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code3, "a"),
-      "Invalid initializer in for loop -- must initialize iterator");
+  expectBuildError(code3, "a",
+                   "Invalid initializer in for loop -- must initialize iterator");
 }
 
-TEST_F(ComputationBuilderDeathTest, for_incorrect_condition_fails) {
+TEST_F(ComputationBuilderErrorTest, for_incorrect_condition_fails) {
   std::string code1 =
       "int a() {\
     int x;\
@@ -449,9 +1103,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_condition_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code1, "a"),
-      "Invalid condition in for loop -- must be a binary operation");
+  expectBuildError(code1, "a",
+                   "Invalid condition in for loop -- must be a binary operation");
 
   std::string code2 =
       "int a() {\
@@ -461,12 +1114,11 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_condition_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code2, "a"),
-      "Invalid condition in for loop -- must be present");
+  expectBuildError(code2, "a",
+                   "Invalid condition in for loop -- must be present");
 }
 
-TEST_F(ComputationBuilderDeathTest, for_incorrect_increment_fails) {
+TEST_F(ComputationBuilderErrorTest, for_incorrect_increment_fails) {
   std::string code1 =
       "int a() {\
     int x;\
@@ -475,9 +1127,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_increment_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code1, "a"),
-      "Invalid increment in for loop -- must increase iterator by 1");
+  expectBuildError(code1, "a",
+                   "Invalid increment in for loop -- must increase iterator by 1");
 
   std::string code2 =
       "int a() {\
@@ -487,9 +1138,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_increment_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code2, "a"),
-      "Invalid increment in for loop -- must increase iterator by 1");
+  expectBuildError(code2, "a",
+                   "Invalid increment in for loop -- must increase iterator by 1");
 
   std::string code3 =
       "int a() {\
@@ -499,9 +1149,8 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_increment_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code3, "a"),
-      "Invalid increment in for loop -- must increase iterator by 1");
+  expectBuildError(code3, "a",
+                   "Invalid increment in for loop -- must increase iterator by 1");
 
   std::string code4 =
       "int a() {\
@@ -511,12 +1160,11 @@ TEST_F(ComputationBuilderDeathTest, for_incorrect_increment_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code4, "a"),
-      "Invalid increment in for loop -- must be present");
+  expectBuildError(code4, "a",
+                   "Invalid increment in for loop -- must be present");
 }
 
-TEST_F(ComputationBuilderDeathTest, loop_invariant_violation_fails) {
+TEST_F(ComputationBuilderErrorTest, loop_invariant_violation_fails) {
   std::string code1 =
       "void a() {\
     int x[5];\
@@ -527,8 +1175,8 @@ TEST_F(ComputationBuilderDeathTest, loop_invariant_violation_fails) {
         x[2] = 3;\
     }\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code1, "a"),
-               "Code may not modify loop-invariant data space 'x'");
+  expectBuildError(code1, "a",
+                   "Code may not modify loop-invariant data space 'x'");
 
   std::string code2 =
       "int* a() {\
@@ -538,11 +1186,11 @@ TEST_F(ComputationBuilderDeathTest, loop_invariant_violation_fails) {
     }\
     return N;\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code2, "a"),
-               "Code may not modify loop-invariant data space 'N'");
+  expectBuildError(code2, "a",
+                   "Code may not modify loop-invariant data space 'N'");
 }
 
-TEST_F(ComputationBuilderDeathTest, unsupported_statement_fails) {
+TEST_F(ComputationBuilderErrorTest, unsupported_statement_fails) {
   std::string code =
       "int a() {\
     int x;\
@@ -553,11 +1201,11 @@ TEST_F(ComputationBuilderDeathTest, unsupported_statement_fails) {
     goto asdf;\
     return x;\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code, "a"),
-               "Unsupported stmt type LabelStmt");
+  expectBuildError(code, "a",
+                   "Unsupported stmt type LabelStmt");
 }
 
-TEST_F(ComputationBuilderDeathTest, invalid_condition_fails) {
+TEST_F(ComputationBuilderErrorTest, invalid_condition_fails) {
   std::string code1 =
       "int a() {\
     int x = 0;\
@@ -566,8 +1214,8 @@ TEST_F(ComputationBuilderDeathTest, invalid_condition_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code1, "a"),
-               "If statement condition must be a binary operation");
+  expectBuildError(code1, "a",
+                   "If statement condition must be a binary operation");
 
   std::string code2 =
       "int a() {\
@@ -577,8 +1225,8 @@ TEST_F(ComputationBuilderDeathTest, invalid_condition_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code2, "a"),
-               "If statement condition must be a binary operation");
+  expectBuildError(code2, "a",
+                   "If statement condition must be a binary operation");
 
   std::string code3 =
       "int a() {\
@@ -588,12 +1236,11 @@ TEST_F(ComputationBuilderDeathTest, invalid_condition_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(
-      buildComputationFromCode(code3, "a"),
-      "Not-equal conditions are unsupported by SPF: in condition x != 0");
+  expectBuildError(code3, "a",
+                   "Not-equal conditions are unsupported by SPF: in condition x != 0");
 }
 
-TEST_F(ComputationBuilderDeathTest, reusing_var_name_fails) {
+TEST_F(ComputationBuilderErrorTest, reusing_var_name_fails) {
   std::string code =
       "int a() {\
     int x = 5;\
@@ -602,11 +1249,11 @@ TEST_F(ComputationBuilderDeathTest, reusing_var_name_fails) {
     }\
     return x;\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code, "a"),
-               "Declaring a variable with a name that has already been used in another scope is disallowed");
+  expectBuildError(code, "a",
+                   "Declaring a variable with a name that has already been used in another scope is disallowed");
 }
 
-TEST_F(ComputationBuilderDeathTest, return_in_compound_stmt_disallowed) {
+TEST_F(ComputationBuilderErrorTest, return_in_compound_stmt_disallowed) {
   std::string code =
       "int a() {\
     int x = 5;\
@@ -614,11 +1261,11 @@ TEST_F(ComputationBuilderDeathTest, return_in_compound_stmt_disallowed) {
         return 1;\
     }\
 }";
-  ASSERT_DEATH(buildComputationFromCode(code, "a"),
-               "Return within nested structures is disallowed");
+  expectBuildError(code, "a",
+                   "Return within nested structures is disallowed");
 }
 
-TEST_F(ComputationBuilderDeathTest, func_arg_too_complex) {
+TEST_F(ComputationBuilderErrorTest, func_arg_too_complex) {
   std::string code1 =
       "int inner(int);\n"
       "int outer(void) {\n"
@@ -629,8 +1276,8 @@ TEST_F(ComputationBuilderDeathTest, func_arg_too_complex) {
       "int inner(int x) {\n"
       "  return x;\n"
       "}";
-  ASSERT_DEATH(buildComputationFromCode(code1, "outer"),
-               "Argument passed to function is too complex");
+  expectBuildError(code1, "outer",
+                   "Argument passed to function is too complex");
   std::string code2 =
       "int inner(int);\n"
       "int outer(void) {\n"
@@ -640,8 +1287,8 @@ TEST_F(ComputationBuilderDeathTest, func_arg_too_complex) {
       "int inner(int x) {\n"
       "  return x;\n"
       "}";
-  ASSERT_DEATH(buildComputationFromCode(code2, "outer"),
-               "Argument passed to function is too complex");
+  expectBuildError(code2, "outer",
+                   "Argument passed to function is too complex");
   std::string code3 =
       "int inner(int);\n"
       "int outer(void) {\n"
@@ -652,45 +1299,68 @@ TEST_F(ComputationBuilderDeathTest, func_arg_too_complex) {
       "int inner(int x) {\n"
       "  return x;\n"
       "}";
-  ASSERT_DEATH(buildComputationFromCode(code3, "outer"),
-               "Argument passed to function is too complex");
+  expectBuildError(code3, "outer",
+                   "Argument passed to function is too complex");
 }
 
-TEST_F(ComputationBuilderDeathTest, called_func_not_defined) {
+TEST_F(ComputationBuilderErrorTest, called_func_not_defined) {
   std::string code =
       "int inner(int);\n"
       "int outer(void) {\n"
       "  int x = inner(0);\n"
       "  return x;\n"
       "}\n";
-  ASSERT_DEATH(buildComputationFromCode(code, "outer"),
-               "Cannot find definition for called function");
+  expectBuildError(code, "outer",
+                   "Cannot find definition for called function");
+}
+
+//! Test that a call is not outlined to hide what the called function
+//! accesses besides its arguments, which inlining it rejects
+TEST_F(ComputationBuilderErrorTest, outlined_callee_writing_global_fails) {
+  std::string code =
+      "int total;\n"
+      "void add(int x) {\n"
+      "  total += x;\n"
+      "}\n"
+      "void caller(int n) {\n"
+      "  add(n);\n"
+      "}\n";
+  expectBuildError(code, "caller",
+                   "Data space 'total' is not declared in the function");
+  BuildOptions options;
+  options.maxInlineDepth = 0;
+  expectBuildError(code, "caller",
+                   "Data space 'total' is not declared in the function", options);
+  options = BuildOptions();
+  options.inlineBudget = 0;
+  expectBuildError(code, "caller",
+                   "Data space 'total' is not declared in the function", options);
 }
 
-TEST_F(ComputationBuilderDeathTest, return_too_complex) {
+TEST_F(ComputationBuilderErrorTest, return_too_complex) {
   std::string code1 =
       "int a(void) {\n"
       "  return 3+5;\n"
       "}\n";
-  ASSERT_DEATH(buildComputationFromCode(code1, "a"),
-               "Return value is too complex");
+  expectBuildError(code1, "a",
+                   "Return value is too complex");
   std::string code2 =
       "int a(void) {\n"
       "  int x = 5;"
       "  return 3+x;\n"
       "}\n";
-  ASSERT_DEATH(buildComputationFromCode(code2, "a"),
-               "Return value is too complex");
+  expectBuildError(code2, "a",
+                   "Return value is too complex");
   std::string code3 =
       "int a(void) {\n"
       "  int* x;"
       "  return x[0];\n"
       "}\n";
-  ASSERT_DEATH(buildComputationFromCode(code3, "a"),
-               "Return value is too complex");
+  expectBuildError(code3, "a",
+                   "Return value is too complex");
 }
 
-TEST_F(ComputationBuilderDeathTest, condition_variables_disallowed) {
+TEST_F(ComputationBuilderErrorTest, condition_variables_disallowed) {
   std::string code =
       "int a(void) {\
          if (int x = 3)) {\
@@ -698,8 +1368,8 @@ TEST_F(ComputationBuilderDeathTest, condition_variables_disallowed) {
          }\
          return 2;\
       }";
-  ASSERT_DEATH(buildComputationFromCode(code, "a"),
-               "If statement condition variable declarations are unsupported");
+  expectBuildError(code, "a",
+                   "If statement condition variable declarations are unsupported");
 }
 
 //! Set up and run tests
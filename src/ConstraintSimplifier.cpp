@@ -0,0 +1,205 @@
+#include "ConstraintSimplifier.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Stats.hpp"
+#include "iegenlib.h"
+#include "llvm/Support/TimeProfiler.h"
+
+namespace spf_ie {
+
+namespace {
+
+//! A constraint split into its constant term and the rest, each of which
+//! means "terms + constant >= 0" (or "= 0", for equalities)
+struct AffineConstraint {
+  //! Terms other than the constant
+  std::unique_ptr<iegenlib::Exp> terms;
+  //! Constant term
+  int constant = 0;
+  //! The terms as a string, the same for constraints differing only in
+  //! their constant term
+  std::string key;
+  //! Key of the negated terms
+  std::string negatedKey;
+};
+
+AffineConstraint split(const iegenlib::Exp &exp) {
+  AffineConstraint constraint;
+  constraint.terms.reset(exp.clone());
+  for (const auto *term: exp.getTermList()) {
+    if (term->isConst()) {
+      constraint.constant += term->coefficient();
+    }
+  }
+  if (constraint.constant != 0) {
+    constraint.terms->addTerm(new iegenlib::Term(-constraint.constant));
+  }
+  constraint.key = constraint.terms->toString();
+  std::unique_ptr<iegenlib::Exp> negated(constraint.terms->clone());
+  negated->multiplyBy(-1);
+  constraint.negatedKey = negated->toString();
+  return constraint;
+}
+
+//! Turn "terms + constant" into "-terms - constant", which is the same
+//! equality
+void negate(AffineConstraint &constraint) {
+  constraint.terms->multiplyBy(-1);
+  constraint.constant = -constraint.constant;
+  std::swap(constraint.key, constraint.negatedKey);
+}
+
+//! Write an equality from whichever side gives the smaller key, so that
+//! equal equalities have equal keys
+void normalizeEquality(AffineConstraint &equality) {
+  if (equality.negatedKey < equality.key) {
+    negate(equality);
+  }
+}
+
+iegenlib::Exp *join(const AffineConstraint &constraint) {
+  iegenlib::Exp *exp = constraint.terms->clone();
+  if (constraint.constant != 0) {
+    exp->addTerm(new iegenlib::Term(constraint.constant));
+  }
+  return exp;
+}
+
+//! Simplify the constraints of one conjunction of a set
+//! \param[in] conjunction Conjunction to simplify
+//! \param[out] numRemoved Incremented by the number of constraints removed
+//! \return The simplified conjunction, owned by the caller, or null if
+//! nothing could be removed
+iegenlib::Conjunction *simplifyConjunction(const iegenlib::Conjunction &conjunction, unsigned int &numRemoved) {
+  unsigned int numRemovedHere = 0;
+
+  std::vector<AffineConstraint> equalities;
+  // constant of the first equality with each key
+  std::map<std::string, int> equalityConstants;
+  for (const auto *exp: conjunction.equalities()) {
+    AffineConstraint equality = split(*exp);
+    normalizeEquality(equality);
+    auto found = equalityConstants.find(equality.key);
+    if (found != equalityConstants.end() && found->second == equality.constant) {
+      numRemovedHere++;
+      continue;
+    }
+    equalityConstants.emplace(equality.key, equality.constant);
+    equalities.push_back(std::move(equality));
+  }
+
+  // f + c >= 0 is implied by f + d >= 0 whenever c >= d, so only the
+  // tightest inequality with each key is kept
+  std::vector<AffineConstraint> inequalities;
+  std::map<std::string, size_t> inequalityPositions;
+  for (const auto *exp: conjunction.inequalities()) {
+    AffineConstraint inequality = split(*exp);
+    auto found = inequalityPositions.find(inequality.key);
+    if (found != inequalityPositions.end()) {
+      auto &kept = inequalities[found->second];
+      kept.constant = std::min(kept.constant, inequality.constant);
+      numRemovedHere++;
+      continue;
+    }
+    inequalityPositions.emplace(inequality.key, inequalities.size());
+    inequalities.push_back(std::move(inequality));
+  }
+
+  std::vector<bool> dropped(inequalities.size(), false);
+  for (size_t i = 0; i < inequalities.size(); ++i) {
+    if (dropped[i]) {
+      continue;
+    }
+    const auto &inequality = inequalities[i];
+    // f + e = 0 fixes f at -e, implying f + c >= 0 when c >= e, and
+    // -f + e = 0 fixes f at e, implying f + c >= 0 when c + e >= 0
+    auto equal = equalityConstants.find(inequality.key);
+    auto negatedEqual = equalityConstants.find(inequality.negatedKey);
+    if ((equal != equalityConstants.end() && inequality.constant >= equal->second) ||
+        (negatedEqual != equalityConstants.end() && inequality.constant + negatedEqual->second >= 0)) {
+      dropped[i] = true;
+      numRemovedHere++;
+      continue;
+    }
+    // f + c >= 0 and -f - c >= 0 together say f + c = 0
+    auto opposite = inequalityPositions.find(inequality.negatedKey);
+    if (opposite != inequalityPositions.end() && opposite->second > i && !dropped[opposite->second] &&
+        inequalities[opposite->second].constant == -inequality.constant) {
+      dropped[i] = true;
+      dropped[opposite->second] = true;
+      AffineConstraint equality;
+      equality.terms.reset(inequality.terms->clone());
+      equality.constant = inequality.constant;
+      equality.key = inequality.key;
+      equality.negatedKey = inequality.negatedKey;
+      normalizeEquality(equality);
+      equalityConstants.emplace(equality.key, equality.constant);
+      equalities.push_back(std::move(equality));
+      numRemovedHere++;
+    }
+  }
+
+  if (numRemovedHere == 0) {
+    return nullptr;
+  }
+  numRemoved += numRemovedHere;
+  auto *simplified = new iegenlib::Conjunction(conjunction.arity());
+  simplified->setTupleDecl(conjunction.getTupleDecl());
+  for (const auto &equality: equalities) {
+    simplified->addEquality(join(equality));
+  }
+  for (size_t i = 0; i < inequalities.size(); ++i) {
+    if (!dropped[i]) {
+      simplified->addInequality(join(inequalities[i]));
+    }
+  }
+  return simplified;
+}
+
+}  // namespace
+
+/* ConstraintSimplifier */
+
+unsigned int ConstraintSimplifier::simplify(iegenlib::Computation *computation) {
+  llvm::TimeTraceScope timeScope("simplifyConstraints", computation->getName());
+  unsigned int numRemoved = 0;
+  for (unsigned int i = 0; i < computation->getNumStmts(); ++i) {
+    iegenlib::Stmt *stmt = computation->getStmt(i);
+    if (iegenlib::Set *simplified = simplify(stmt->getIterationSpace(), numRemoved)) {
+      stmt->setIterationSpace(simplified);
+    }
+  }
+  Stats::increment(Stats::ConstraintsRemoved, numRemoved);
+  return numRemoved;
+}
+
+iegenlib::Set *ConstraintSimplifier::simplify(const iegenlib::Set *set, unsigned int &numRemoved) {
+  std::vector<std::unique_ptr<iegenlib::Conjunction>> conjunctions;
+  bool changed = false;
+  for (auto it = set->conjunctionBegin(); it != set->conjunctionEnd(); ++it) {
+    std::unique_ptr<iegenlib::Conjunction> simplified(simplifyConjunction(**it, numRemoved));
+    if (simplified) {
+      changed = true;
+    } else {
+      simplified.reset(new iegenlib::Conjunction(**it));
+    }
+    conjunctions.push_back(std::move(simplified));
+  }
+  if (!changed) {
+    return nullptr;
+  }
+  auto *result = new iegenlib::Set(set->arity());
+  for (auto &conjunction: conjunctions) {
+    result->addConjunction(conjunction.release());
+  }
+  result->cleanUp();
+  return result;
+}
+
+}  // namespace spf_ie
@@ -7,7 +7,8 @@
 
 #include "Driver.hpp"
 #include "Utils.hpp"
-#include "ComputationBuilder.hpp"
+#include "PositionContext.hpp"
+#include "Stats.hpp"
 #include "clang/AST/Expr.h"
 
 using namespace clang;
@@ -16,13 +17,16 @@ namespace spf_ie {
 
 /* DataAccess */
 
-std::string DataAccess::toString(const std::vector<DataAccess> &potentialSubaccesses) const {
+const DataAccessId DataAccess::NoAccess;
+
+std::string DataAccess::toString(const std::vector<DataAccess> &accesses) const {
   std::ostringstream os;
   os << this->name;
   if (this->isArrayAccess) {
     os << "(";
     bool first = true;
-    for (const auto &it: this->indexes) {
+    for (unsigned int i = 0; i < this->indexes.size(); ++i) {
+      Expr *it = this->indexes[i];
       if (!first) {
         os << ",";
       } else {
@@ -31,32 +35,35 @@ std::string DataAccess::toString(const std::vector<DataAccess> &potentialSubacce
       std::string indexString;
       if (auto *asArrayAccess = dyn_cast<ArraySubscriptExpr>(it->IgnoreParenImpCasts())) {
         // there is another array access used as an index for this one
-        bool foundSubaccess = false;
-        for (const auto &it: potentialSubaccesses) {
-          if (it.sourceId == asArrayAccess->getID(*Context)) {
-            foundSubaccess = true;
-            indexString = it.toString(potentialSubaccesses);
-            break;
-          }
-        }
-        if (!foundSubaccess) {
-          Utils::printErrorAndExit(
+        if (const DataAccess *subaccess = getSubaccess(i, accesses)) {
+          indexString = subaccess->toString(accesses);
+        } else {
+          Utils::raiseError(
               "Could not stringify array access because its sub-access "
               "had (printed below) not already been processed.\nThis "
               "point should be unreachable -- this is a bug.",
               asArrayAccess);
         }
       } else {
-        indexString = Utils::stmtToString(it);
+        indexString = Utils::stmtToString(it).str();
       }
       os <<
          indexString;
     }
+    for (unsigned int i = 0; i < this->wholeArrayDims; ++i) {
+      os << (i == 0 ? "*" : ",*");
+    }
     os << ")";
   }
   return os.str();
 }
 
+const DataAccess *DataAccess::getSubaccess(unsigned int indexPosition,
+                                           const std::vector<DataAccess> &accesses) const {
+  DataAccessId id = subaccesses[indexPosition];
+  return id == NoAccess ? nullptr : &accesses[id];
+}
+
 /* DataAccessHandler */
 
 void DataAccessHandler::processExprAsRead(Expr *expr) {
@@ -76,39 +83,65 @@ void DataAccessHandler::processWriteToScalarName(const std::string &name) {
 }
 
 void DataAccessHandler::processAccessToScalarName(const std::string &name, bool isRead) {
-  if (ComputationBuilder::positionContext->isIteratorName(name)) {
+  if (positionContext->isIteratorName(name)) {
     return;
   }
 
   dataSpacesAccessed.emplace(name);
-  stmtDataAccesses.push_back(DataAccess(name, 0, isRead, false, {}));
+  stmtDataAccesses.push_back(DataAccess(name, isRead, false, {}));
+  Stats::increment(Stats::DataAccessesRecorded);
+}
+
+void DataAccessHandler::processAccessToWholeArray(const std::string &name, unsigned int numDims, bool isRead) {
+  dataSpacesAccessed.emplace(name);
+  DataAccess access(name, isRead, true, {});
+  access.wholeArrayDims = numDims;
+  stmtDataAccesses.push_back(std::move(access));
+  Stats::increment(Stats::DataAccessesRecorded);
 }
 
 void DataAccessHandler::processSingleAccessExpr(Expr *fullExpr,
                                                 bool isRead) {
-  auto accesses = makeDataAccessesFromExpr(fullExpr, isRead);
+  auto accesses = makeDataAccessesFromExpr(fullExpr, isRead, *positionContext);
 
-  for (const auto &access: accesses) {
+  // IDs of the new accesses among the statement's
+  std::vector<DataAccessId> stmtIds(accesses.size(), DataAccess::NoAccess);
+  for (DataAccessId id = 0; id < accesses.size(); ++id) {
     // skip counting iterators as data accesses
-    if (ComputationBuilder::positionContext->isIteratorName(access.name)) {
+    if (positionContext->isIteratorName(accesses[id].name)) {
       continue;
     }
-    dataSpacesAccessed.emplace(access.name);
-    stmtDataAccesses.push_back(access);
+    dataSpacesAccessed.emplace(accesses[id].name);
+    stmtIds[id] = stmtDataAccesses.size();
+    stmtDataAccesses.push_back(std::move(accesses[id]));
+    Stats::increment(Stats::DataAccessesRecorded);
+  }
+  // re-point the graph's edges at the statement's IDs
+  auto toStmtId = [&](DataAccessId id) {
+    return id == DataAccess::NoAccess ? id : stmtIds[id];
+  };
+  for (DataAccessId id: stmtIds) {
+    if (id == DataAccess::NoAccess) {
+      continue;
+    }
+    auto &access = stmtDataAccesses[id];
+    for (auto &subaccess: access.subaccesses) {
+      subaccess = toStmtId(subaccess);
+    }
+    access.enclosingAccess = toStmtId(access.enclosingAccess);
   }
 }
 
 std::vector<DataAccess> DataAccessHandler::makeDataAccessesFromExpr(
-    Expr *fullExpr, bool isRead) {
+    Expr *fullExpr, bool isRead, const PositionContext &positionContext) {
   std::vector<DataAccess> accesses;
   if (auto *asArraySubscriptExpr =
       dyn_cast<ArraySubscriptExpr>(fullExpr)) {
     doBuildArrayAccessWork(asArraySubscriptExpr, isRead, accesses);
   } else if (auto *asDeclRefExpr = dyn_cast<DeclRefExpr>(fullExpr)) {
-    std::string varName = Utils::stmtToString(asDeclRefExpr);
-    if (!ComputationBuilder::positionContext->isIteratorName(varName)) {
+    if (!positionContext.isIteratorName(asDeclRefExpr->getDecl()->getName())) {
       accesses.emplace_back(
-          DataAccess(varName, asDeclRefExpr->getID(*Context), isRead, false, {}));
+          DataAccess(Utils::stmtToString(asDeclRefExpr).str(), isRead, false, {}));
     }
   }
   return accesses;
@@ -130,34 +163,44 @@ int DataAccessHandler::getArrayExprInfo(ArraySubscriptExpr *fullExpr,
   }
 }
 
-void DataAccessHandler::doBuildArrayAccessWork(ArraySubscriptExpr *fullExpr,
-                                               bool isRead,
-                                               std::vector<DataAccess> &existingAccesses) {
+DataAccessId DataAccessHandler::doBuildArrayAccessWork(ArraySubscriptExpr *fullExpr,
+                                                       bool isRead,
+                                                       std::vector<DataAccess> &existingAccesses) {
   // extract information from subscript expression
   std::stack<Expr *> info;
   if (!getArrayExprInfo(fullExpr, &info)) {
-    Utils::printErrorAndExit("Array dimension exceeds maximum of " +
-                                 std::to_string(MAX_ARRAY_DIM),
-                             fullExpr);
+    Utils::raiseError("Array dimension exceeds maximum of " +
+                          std::to_string(MAX_ARRAY_DIM),
+                      fullExpr);
   }
 
   // construct DataAccess object
   Expr *baseAccess = info.top();
   info.pop();
   std::vector<Expr *> indexes;
+  std::vector<DataAccessId> subaccesses;
   while (!info.empty()) {
     // recurse when an index is itself another array access; such
     // sub-accesses are always reads
     if (auto *indexAsArrayAccess =
         dyn_cast<ArraySubscriptExpr>(info.top())) {
-      doBuildArrayAccessWork(indexAsArrayAccess, true, existingAccesses);
+      subaccesses.push_back(doBuildArrayAccessWork(indexAsArrayAccess, true, existingAccesses));
+    } else {
+      subaccesses.push_back(DataAccess::NoAccess);
     }
     indexes.push_back(info.top());
     info.pop();
   }
 
+  DataAccessId id = existingAccesses.size();
+  for (DataAccessId subaccess: subaccesses) {
+    if (subaccess != DataAccess::NoAccess) {
+      existingAccesses[subaccess].enclosingAccess = id;
+    }
+  }
   existingAccesses
-      .emplace_back(DataAccess(Utils::stmtToString(baseAccess), fullExpr->getID(*Context), isRead, true, indexes));
+      .emplace_back(DataAccess(Utils::stmtToString(baseAccess).str(), isRead, true, indexes, subaccesses));
+  return id;
 }
 
 }  // namespace spf_ie
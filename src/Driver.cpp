@@ -11,20 +11,48 @@
 
 #include "Driver.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
+#include "BuildContext.hpp"
+#include "CodeGen.hpp"
 #include "ComputationBuilder.hpp"
+#include "FunctionIndex.hpp"
+#include "ResultCache.hpp"
+#include "SPFError.hpp"
+#include "Server.hpp"
+#include "Stats.hpp"
+#include "SummaryStore.hpp"
 #include "Utils.hpp"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclBase.h"
+#include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace clang;
 using namespace clang::tooling;
@@ -32,71 +60,479 @@ using namespace clang::tooling;
 static llvm::cl::opt<bool> FrontendOnly(
     "frontend-only", llvm::cl::desc("Just run the spf-ie frontend and output Computation IR to console"));
 
-static llvm::cl::opt<std::string> EntryPoint(
+static llvm::cl::opt<CodeGenBackend> CodeGenOption(
+    "codegen", llvm::cl::desc("Library to generate loop nests with"),
+    llvm::cl::values(
+        clEnumValN(CodeGenBackend::Omega, "omega", "Omega, through IEGenLib (default)"),
+        clEnumValN(CodeGenBackend::Isl, "isl",
+                   "isl's AST builder, falling back to Omega for iteration spaces with "
+                   "uninterpreted function calls")),
+    llvm::cl::init(CodeGenBackend::Omega));
+
+static llvm::cl::list<std::string> EntryPoints(
     "entry-point", llvm::cl::desc(
-        "Entry point for the spf-ie tool, only the specified "
-        "function will be translated"));
+        "Entry point(s) for the spf-ie tool, only the specified "
+        "functions will be translated. Accepts a comma-separated list "
+        "and may be given more than once"),
+    llvm::cl::CommaSeparated);
+
+static llvm::cl::opt<bool> AllFunctions(
+    "all-functions", llvm::cl::desc(
+        "Translate every function defined in the input file(s), "
+        "instead of only the --entry-point function(s)"));
+
+static llvm::cl::opt<std::string> OutputDir(
+    "output-dir", llvm::cl::desc(
+        "Write each function's result to its own file in this directory "
+        "(named <source file>.<function>.c, or .ir with --frontend-only) "
+        "instead of to standard output"));
+
+static llvm::cl::opt<unsigned> NumJobs(
+    "j", llvm::cl::desc(
+        "Number of input files to parse in parallel (0 to use all cores); "
+        "functions are still built and generated one at a time"),
+    llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> MaxInlineDepth(
+    "max-inline-depth", llvm::cl::desc(
+        "Inline at most this many levels of nested calls (1 for only calls "
+        "made directly from the function being translated), leaving deeper "
+        "calls in place as opaque statements. Unlimited by default"));
+
+static llvm::cl::opt<unsigned> InlineBudget(
+    "inline-budget", llvm::cl::desc(
+        "Inline calls only while each Computation stays within this many "
+        "statements, leaving the rest in place as opaque statements. "
+        "Unlimited by default"));
+
+static llvm::cl::opt<bool> MergeStmts(
+    "merge-stmts", llvm::cl::desc(
+        "Merge consecutive statements in the same loop body or branch into "
+        "one statement where they do not depend on each other, so that "
+        "codegen has fewer statements to schedule"));
+
+static llvm::cl::opt<bool> FoldDeclarations(
+    "fold-declarations", llvm::cl::desc(
+        "Leave declarations without initializers out of the Computation, "
+        "instead of making statements of them"));
+
+static llvm::cl::opt<bool> SimplifyConstraints(
+    "simplify-constraints", llvm::cl::desc(
+        "Remove duplicate and implied constraints from each statement's "
+        "iteration space before codegen"));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir", llvm::cl::desc(
+        "Directory in which to cache results, reusing them for functions "
+        "whose source (and that of their callees) is unchanged"));
+
+static llvm::cl::opt<std::string> SummaryDir(
+    "summary-dir", llvm::cl::desc(
+        "Directory in which to store the Computations built from called "
+        "functions, loading them instead of building the functions again "
+        "while their source is unchanged"));
+
+static llvm::cl::opt<bool> PrintStats(
+    "stats", llvm::cl::desc(
+        "Print wall time and call counts of each phase, and counters of "
+        "work done, to standard error on exit"));
+
+static llvm::cl::opt<std::string> StatsJSON(
+    "stats-json", llvm::cl::desc(
+        "Write the --stats report as JSON to the given file on exit"));
+
+static llvm::cl::opt<std::string> TraceFile(
+    "trace", llvm::cl::desc(
+        "Write a Chrome trace-event (Perfetto-compatible) trace of parsing, "
+        "building, finalize and codegen to the given file on exit"));
+
+static llvm::cl::opt<bool> Scan(
+    "scan", llvm::cl::desc(
+        "Only check which functions can be translated, without translating "
+        "them, and print a JSON report of accepted functions, rejection "
+        "reasons and loop nest statistics. Scans every function in every "
+        "file of the compilation database unless told otherwise"));
+
+static llvm::cl::opt<bool> CrossTU(
+    "cross-tu", llvm::cl::desc(
+        "Inline calls to functions defined in other files of the compilation "
+        "database (or in the other input files, if it lists none), indexing "
+        "their definitions before translating"));
+
+static llvm::cl::opt<bool> Serve(
+    "serve", llvm::cl::desc(
+        "Run as a persistent server, accepting translation requests on a "
+        "local socket (see --socket)"));
+
+static llvm::cl::opt<std::string> SocketPath(
+    "socket", llvm::cl::desc(
+        "Path of the Unix socket to listen on with --serve (default "
+        "spf-ie.sock in $XDG_RUNTIME_DIR, or in /tmp/spf-ie-<uid>)"));
 
 namespace spf_ie {
 
-const ASTContext *Context;
+thread_local const ASTContext *Context;
+
+//! Serializes work that touches IEGenLib, which keeps global state (such as
+//! its rename counters) and is not safe to use from several threads at once.
+//! Held while building, generating code for, and writing out functions, so
+//! only Clang's parsing of separate files actually runs in parallel.
+static std::mutex iegenlibMutex;
+
+//! Serializes updates to the TranslationOutcome when scanning, which does
+//! not use IEGenLib and so runs entirely in parallel
+static std::mutex outcomeMutex;
 
 class SPFConsumer : public ASTConsumer {
 public:
-  explicit SPFConsumer(llvm::StringRef fileName) : fileName(fileName.str()) {}
-  void HandleTranslationUnit(ASTContext &Ctx) override {
-    if (EntryPoint.empty()) {
-      llvm::errs() << "\033[31m--entry-point flag must be specified (-h for usage)\033[0m\n";
-      exit(1);
+  SPFConsumer(llvm::StringRef fileName, const TranslationRequest &request, llvm::raw_ostream &out,
+              TranslationOutcome &outcome)
+      : fileName(fileName.str()), request(request), out(out), outcome(outcome),
+        parseTimer(Stats::Parse) {
+    if (!request.cacheDir.empty()) {
+      cache.reset(new ResultCache(request.cacheDir));
+    }
+    if (!request.summaryDir.empty()) {
+      summaries.reset(new SummaryStore(request.summaryDir));
     }
+    build.functionIndex = request.functionIndex;
+    build.summaries = summaries.get();
+    build.options = request.buildOptions;
+  }
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    parseTimer.stop();
     // initializing globally-accessible ASTContext
     Context = &Ctx;
+    if (request.scan) {
+      scanTranslationUnit();
+      return;
+    }
+    std::lock_guard<std::mutex> lock(iegenlibMutex);
     llvm::errs() << "\nProcessing: " << fileName << "\n";
     llvm::errs()
         << "=================================================\n\n";
-    ComputationBuilder builder;
-    // locate and process the target function
-    bool builtAComputation = false;
+    // locate and process the target function(s), all from this one parse
     for (auto it: Context->getTranslationUnitDecl()->decls()) {
       auto *func = dyn_cast<FunctionDecl>(it);
-      if (func && func->doesThisDeclarationHaveABody() &&
-          func->getQualifiedNameAsString() == EntryPoint) {
-        iegenlib::Computation *computation =
-            builder.buildComputationFromFunction(func);
-        builtAComputation = true;
-        if (FrontendOnly) {
-          llvm::errs()
-              << "Computation IR for function '" << func->getQualifiedNameAsString()
-              << "'\n";
-          llvm::errs() << "---------------\n\n";
-          computation->printInfo();
-        } else {
-          llvm::errs() << "Codegen for function '" << func->getQualifiedNameAsString() << "':\n\n";
-          computation->finalize();
-          std::string codegen = computation->codeGen();
-          llvm::outs() << codegen;
-        }
-        delete computation;
+      if (func && func->doesThisDeclarationHaveABody() && isTargetFunction(func)) {
+        processFunction(func);
       }
     }
-    if (!builtAComputation) {
-      llvm::errs() << "Could not locate definition of the target function '" << EntryPoint << "'!\n";
-      exit(1);
-    }
+    reportOutlinedCalls();
   }
 
 private:
   std::string fileName;
+  const TranslationRequest &request;
+  //! Stream receiving results not written to their own files
+  llvm::raw_ostream &out;
+  //! Functions found and failed so far, across all files
+  TranslationOutcome &outcome;
+  //! State shared by builds of all functions in this translation unit
+  BuildContext build;
+  //! Cache of earlier results, if in use
+  std::unique_ptr<ResultCache> cache;
+  //! Summaries of called functions, if in use
+  std::unique_ptr<SummaryStore> summaries;
+  //! Times parsing, which runs from this consumer's creation until the translation unit is handed to it
+  PhaseTimer parseTimer;
+
+  //! Check whether the given function (which has a body) was requested for translation
+  bool isTargetFunction(FunctionDecl *func) {
+    if (request.allFunctions) {
+      // skip functions pulled in from headers
+      return Context->getSourceManager().isInMainFile(func->getLocation());
+    }
+    std::string funcName = func->getQualifiedNameAsString();
+    for (const auto &entryPoint: request.entryPoints) {
+      if (entryPoint == funcName) {
+        std::lock_guard<std::mutex> lock(outcomeMutex);
+        outcome.foundEntryPoints.emplace(funcName);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //! Check whether each target function can be translated, recording the results
+  void scanTranslationUnit() {
+    std::vector<ScanRecord> records;
+    for (auto it: Context->getTranslationUnitDecl()->decls()) {
+      auto *func = dyn_cast<FunctionDecl>(it);
+      if (!func || !func->doesThisDeclarationHaveABody() || !isTargetFunction(func)) {
+        continue;
+      }
+      ScanRecord record;
+      record.fileName = fileName;
+      record.functionName = func->getQualifiedNameAsString();
+      ComputationBuilder builder(build);
+      auto shape = builder.scanFunction(func);
+      if (shape) {
+        record.accepted = true;
+        record.shape = *shape;
+      } else {
+        llvm::handleAllErrors(shape.takeError(), [&](const SPFError &error) {
+          record.reason = error.getMessage();
+          record.line = error.getLine();
+          record.column = error.getColumn();
+        });
+      }
+      records.push_back(std::move(record));
+    }
+    std::lock_guard<std::mutex> lock(outcomeMutex);
+    outcome.scans.insert(outcome.scans.end(), std::make_move_iterator(records.begin()),
+                         std::make_move_iterator(records.end()));
+  }
+
+  //! Get the function's IR or codegen, from the cache if possible, and write it out
+  void processFunction(FunctionDecl *func) {
+    std::string funcName = func->getQualifiedNameAsString();
+    std::string result;
+    std::string cacheKey;
+    if (cache) {
+      cacheKey = ResultCache::computeKey(func, request.getCacheSettings(), request.functionIndex);
+    }
+    if (cache && cache->lookup(cacheKey, result)) {
+      llvm::errs() << "Using cached result for function '" << funcName << "'\n";
+      Stats::increment(Stats::CacheHits);
+    } else {
+      auto translation = translateFunction(func);
+      if (!translation) {
+        // skip this function, carrying on with the rest
+        std::string message =
+            "Could not translate function '" + funcName + "': " + llvm::toString(translation.takeError());
+        llvm::errs() << "ERROR: " << message << "\n";
+        outcome.errors.push_back(message);
+        return;
+      }
+      result = std::move(*translation);
+      if (cache) {
+        cache->store(cacheKey, result);
+        Stats::increment(Stats::CacheMisses);
+      }
+    }
+
+    if (request.outputDir.empty()) {
+      out << result;
+      out.flush();
+    } else if (auto error = writeResultFile(funcName, result)) {
+      // the result is lost, but other functions (and, when serving, other
+      // requests) can still be written
+      std::string message =
+          "Could not write result of function '" + funcName + "': " + llvm::toString(std::move(error));
+      llvm::errs() << "ERROR: " << message << "\n";
+      outcome.errors.push_back(message);
+    }
+  }
+
+  //! Build a Computation from the function and get its IR or codegen
+  llvm::Expected<std::string> translateFunction(FunctionDecl *func) {
+    std::string funcName = func->getQualifiedNameAsString();
+    // number renamed inlined variables the same as when translating this function alone
+    iegenlib::Computation::resetNumRenamesCounters();
+    ComputationBuilder builder(build);
+    auto built = builder.buildComputationFromFunction(func);
+    if (!built) {
+      return built.takeError();
+    }
+    iegenlib::Computation *computation = *built;
+
+    std::string result;
+    if (request.frontendOnly) {
+      llvm::errs()
+          << "Computation IR for function '" << funcName
+          << "'\n";
+      llvm::errs() << "---------------\n\n";
+      result = getComputationInfo(computation);
+    } else {
+      llvm::errs() << "Codegen for function '" << funcName << "':\n\n";
+      {
+        llvm::TimeTraceScope timeScope("finalize", funcName);
+        PhaseTimer finalizeTimer(Stats::Finalize);
+        computation->finalize();
+      }
+      llvm::TimeTraceScope timeScope("codeGen", funcName);
+      PhaseTimer codeGenTimer(Stats::CodeGen);
+      result = CodeGen::generate(computation, request.codeGenBackend);
+    }
+    delete computation;
+    return result;
+  }
+
+  //! List the calls which were outlined, whose functions must be translated separately
+  void reportOutlinedCalls() {
+    if (build.outlinedCalls.empty()) {
+      return;
+    }
+    llvm::errs() << "Calls outlined rather than inlined (translate these functions separately for their code):\n";
+    for (const auto &it: build.outlinedCalls) {
+      llvm::errs() << "  '" << it.first << "' at ";
+      for (const auto &callSite: it.second) {
+        if (callSite != *it.second.begin()) {
+          llvm::errs() << ", ";
+        }
+        llvm::errs() << callSite;
+      }
+      llvm::errs() << "\n";
+    }
+  }
+
+  //! Write one function's result to its own file in the output directory
+  //! \return An error if the file could not be written
+  llvm::Error writeResultFile(const std::string &funcName, const std::string &result) {
+    if (std::error_code ec = llvm::sys::fs::create_directories(request.outputDir)) {
+      return llvm::make_error<llvm::StringError>(
+          "Could not create output directory '" + request.outputDir + "': " + ec.message(), ec);
+    }
+    llvm::SmallString<128> outPath(request.outputDir);
+    llvm::sys::path::append(outPath, llvm::Twine(llvm::sys::path::filename(fileName)) + "." + funcName +
+        (request.frontendOnly ? ".ir" : ".c"));
+    std::error_code ec;
+    llvm::raw_fd_ostream outFile(outPath, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      return llvm::make_error<llvm::StringError>(
+          "Could not open output file '" + outPath.str().str() + "': " + ec.message(), ec);
+    }
+    outFile << result;
+    outFile.close();
+    if (outFile.has_error()) {
+      ec = outFile.error();
+      outFile.clear_error();
+      return llvm::make_error<llvm::StringError>(
+          "Could not write output file '" + outPath.str().str() + "': " + ec.message(), ec);
+    }
+    llvm::errs() << "Wrote " << outPath << "\n";
+    return llvm::Error::success();
+  }
+
+  //! Get the Computation IR printout, which IEGenLib sends to standard output, as a string
+  static std::string getComputationInfo(iegenlib::Computation *computation) {
+    std::ostringstream info;
+    std::streambuf *coutBuffer = std::cout.rdbuf(info.rdbuf());
+    computation->printInfo();
+    std::cout.rdbuf(coutBuffer);
+    return info.str();
+  }
 };
 
+//! Print the --scan report as JSON, with functions ordered by file and name
+static void printScanReport(std::vector<ScanRecord> &scans, llvm::raw_ostream &os) {
+  std::sort(scans.begin(), scans.end(), [](const ScanRecord &a, const ScanRecord &b) {
+    return std::tie(a.fileName, a.functionName) < std::tie(b.fileName, b.functionName);
+  });
+  int64_t numAccepted = std::count_if(scans.begin(), scans.end(), [](const ScanRecord &record) {
+    return record.accepted;
+  });
+  llvm::json::OStream json(os, 2);
+  json.object([&] {
+    json.attribute("accepted", numAccepted);
+    json.attribute("rejected", (int64_t) scans.size() - numAccepted);
+    json.attributeArray("functions", [&] {
+      for (const auto &record: scans) {
+        json.object([&] {
+          json.attribute("file", record.fileName);
+          json.attribute("function", record.functionName);
+          json.attribute("accepted", record.accepted);
+          if (record.accepted) {
+            json.attribute("statements", (int64_t) record.shape.numStmts);
+            json.attribute("loops", (int64_t) record.shape.numLoops);
+            json.attribute("max_loop_depth", (int64_t) record.shape.maxLoopDepth);
+            json.attribute("ifs", (int64_t) record.shape.numIfs);
+            json.attribute("calls_inlined", (int64_t) record.shape.numCallsInlined);
+          } else {
+            json.attribute("reason", record.reason);
+            if (record.line) {
+              json.attribute("line", (int64_t) record.line);
+              json.attribute("column", (int64_t) record.column);
+            }
+          }
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
+//! Print the --stats report(s) requested
+static void reportStats() {
+  if (PrintStats) {
+    Stats::print(llvm::errs());
+  }
+  if (!StatsJSON.empty()) {
+    std::error_code ec;
+    llvm::raw_fd_ostream statsFile(StatsJSON, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      llvm::errs() << "Could not open stats file '" << StatsJSON << "': " << ec.message() << "\n";
+      return;
+    }
+    Stats::printJSON(statsFile);
+  }
+}
+
+//! Write out the trace, if one is being recorded
+static void writeTrace() {
+  if (!llvm::timeTraceProfilerEnabled()) {
+    return;
+  }
+  std::error_code ec;
+  llvm::raw_fd_ostream traceFile(TraceFile, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "Could not open trace file '" << TraceFile << "': " << ec.message() << "\n";
+  } else {
+    llvm::timeTraceProfilerWrite(traceFile);
+  }
+  llvm::timeTraceProfilerCleanup();
+}
+
 class SPFFrontendAction : public ASTFrontendAction {
 public:
+  SPFFrontendAction(const TranslationRequest &request, llvm::raw_ostream &out,
+                    TranslationOutcome &outcome)
+      : request(request), out(out), outcome(outcome) {}
+
   std::unique_ptr<ASTConsumer> CreateASTConsumer(
       CompilerInstance &Compiler, llvm::StringRef InFile) override {
-    return std::unique_ptr<ASTConsumer>(new SPFConsumer(InFile));
+    return std::unique_ptr<ASTConsumer>(new SPFConsumer(InFile, request, out, outcome));
   }
+
+private:
+  const TranslationRequest &request;
+  llvm::raw_ostream &out;
+  TranslationOutcome &outcome;
 };
 
+class SPFFrontendActionFactory : public FrontendActionFactory {
+public:
+  SPFFrontendActionFactory(const TranslationRequest &request, llvm::raw_ostream &out,
+                           TranslationOutcome &outcome)
+      : request(request), out(out), outcome(outcome) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::unique_ptr<FrontendAction>(new SPFFrontendAction(request, out, outcome));
+  }
+
+private:
+  const TranslationRequest &request;
+  llvm::raw_ostream &out;
+  TranslationOutcome &outcome;
+};
+
+std::string TranslationRequest::getCacheSettings() const {
+  // callees are built on their own when summarized, which can change the
+  // names of their variables
+  std::string mode = (frontendOnly ? "ir" : "codegen");
+  if (!frontendOnly && codeGenBackend == CodeGenBackend::Isl) {
+    mode += ";codegen=isl";
+  }
+  return "mode=" + mode + (summaryDir.empty() ? "" : ";summaries") + buildOptions.describe();
+}
+
+std::unique_ptr<FrontendActionFactory> newSPFActionFactory(
+    const TranslationRequest &request, llvm::raw_ostream &out, TranslationOutcome &outcome) {
+  return std::unique_ptr<FrontendActionFactory>(new SPFFrontendActionFactory(request, out, outcome));
+}
+
 }  // namespace spf_ie
 
 using namespace spf_ie;
@@ -106,10 +542,147 @@ static llvm::cl::OptionCategory SPFToolCategory("spf-ie options");
 //! Instantiate and run the Clang tool
 int main(int argc, const char **argv) {
   FrontendOnly.addCategory(SPFToolCategory);
-  EntryPoint.addCategory(SPFToolCategory);
-  CommonOptionsParser OptionsParser(argc, argv, SPFToolCategory);
-  ClangTool Tool(OptionsParser.getCompilations(),
-                 OptionsParser.getSourcePathList());
+  CodeGenOption.addCategory(SPFToolCategory);
+  EntryPoints.addCategory(SPFToolCategory);
+  AllFunctions.addCategory(SPFToolCategory);
+  OutputDir.addCategory(SPFToolCategory);
+  NumJobs.addCategory(SPFToolCategory);
+  Scan.addCategory(SPFToolCategory);
+  CrossTU.addCategory(SPFToolCategory);
+  MaxInlineDepth.addCategory(SPFToolCategory);
+  InlineBudget.addCategory(SPFToolCategory);
+  MergeStmts.addCategory(SPFToolCategory);
+  FoldDeclarations.addCategory(SPFToolCategory);
+  SimplifyConstraints.addCategory(SPFToolCategory);
+  Serve.addCategory(SPFToolCategory);
+  SocketPath.addCategory(SPFToolCategory);
+  CacheDir.addCategory(SPFToolCategory);
+  SummaryDir.addCategory(SPFToolCategory);
+  PrintStats.addCategory(SPFToolCategory);
+  StatsJSON.addCategory(SPFToolCategory);
+  TraceFile.addCategory(SPFToolCategory);
+  CommonOptionsParser OptionsParser(argc, argv, SPFToolCategory, llvm::cl::ZeroOrMore);
+  if (PrintStats || !StatsJSON.empty()) {
+    Stats::enable();
+  }
+  if (!TraceFile.empty()) {
+    llvm::timeTraceProfilerInitialize(0, "spf-ie");
+  }
+
+  TranslationRequest request;
+  request.codeGenBackend = CodeGenOption;
+  request.cacheDir = CacheDir;
+  request.summaryDir = SummaryDir;
+  if (MaxInlineDepth.getNumOccurrences()) {
+    request.buildOptions.maxInlineDepth = MaxInlineDepth;
+  }
+  if (InlineBudget.getNumOccurrences()) {
+    request.buildOptions.inlineBudget = InlineBudget;
+  }
+  request.buildOptions.mergeStmts = MergeStmts;
+  request.buildOptions.foldDeclarations = FoldDeclarations;
+  request.buildOptions.simplifyConstraints = SimplifyConstraints;
+  if (Serve) {
+    SPFServer server(OptionsParser.getCompilations(), SocketPath, request);
+    int status = server.run();
+    reportStats();
+    writeTrace();
+    return status;
+  }
+
+  std::vector<std::string> sourcePaths = OptionsParser.getSourcePathList();
+  if (Scan) {
+    request.scan = true;
+    if (sourcePaths.empty()) {
+      sourcePaths = OptionsParser.getCompilations().getAllFiles();
+    }
+    if (EntryPoints.empty()) {
+      AllFunctions = true;
+    }
+  }
+  if (sourcePaths.empty()) {
+    llvm::errs() << "\033[31mAt least one input file must be specified (-h for usage)\033[0m\n";
+    return 1;
+  }
+  if (EntryPoints.empty() && !AllFunctions) {
+    llvm::errs() << "\033[31m--entry-point or --all-functions flag must be specified (-h for usage)\033[0m\n";
+    return 1;
+  }
+  request.entryPoints = EntryPoints;
+  request.allFunctions = AllFunctions;
+  request.frontendOnly = FrontendOnly;
+  request.outputDir = OutputDir;
+  TranslationOutcome outcome;
+
+  std::unique_ptr<FunctionIndex> functionIndex;
+  if (CrossTU) {
+    std::vector<std::string> indexedPaths = OptionsParser.getCompilations().getAllFiles();
+    if (indexedPaths.empty()) {
+      indexedPaths = sourcePaths;
+    }
+    functionIndex.reset(new FunctionIndex(OptionsParser.getCompilations()));
+    if (functionIndex->build(indexedPaths)) {
+      llvm::errs() << "WARNING: Some files could not be parsed, so functions defined in them cannot be inlined\n";
+    }
+    llvm::errs() << "Indexed " << functionIndex->size() << " function definition(s) in " << indexedPaths.size()
+                 << " file(s)\n";
+    request.functionIndex = functionIndex.get();
+  }
 
-  return Tool.run(newFrontendActionFactory<SPFFrontendAction>().get());
+  // scanning does not use IEGenLib, so it runs entirely in parallel, on all cores unless told otherwise
+  unsigned int numJobs = (request.scan && !NumJobs.getNumOccurrences() ? 0 : NumJobs.getValue());
+  unsigned int numWorkers = (numJobs == 0 ? std::thread::hardware_concurrency() : numJobs);
+  numWorkers = std::max(1u, std::min<unsigned int>(numWorkers, sourcePaths.size()));
+
+  int status = 0;
+  if (numWorkers == 1) {
+    ClangTool Tool(OptionsParser.getCompilations(), sourcePaths);
+    status = Tool.run(newSPFActionFactory(request, llvm::outs(), outcome).get());
+  } else {
+    // each worker repeatedly claims the next unprocessed file and runs its own tool on it
+    std::atomic<unsigned int> nextSource(0);
+    std::atomic<int> workerStatus(0);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+      workers.emplace_back([&]() {
+        if (!TraceFile.empty()) {
+          llvm::timeTraceProfilerInitialize(0, "spf-ie");
+        }
+        auto actionFactory = newSPFActionFactory(request, llvm::outs(), outcome);
+        for (unsigned int source = nextSource++; source < sourcePaths.size(); source = nextSource++) {
+          ClangTool Tool(OptionsParser.getCompilations(), sourcePaths[source]);
+          if (int result = Tool.run(actionFactory.get())) {
+            workerStatus = result;
+          }
+        }
+        if (!TraceFile.empty()) {
+          // hand this thread's events over to be written with the rest
+          llvm::timeTraceProfilerFinishThread();
+        }
+      });
+    }
+    for (auto &worker: workers) {
+      worker.join();
+    }
+    status = workerStatus;
+  }
+
+  if (!request.allFunctions) {
+    for (const auto &entryPoint: request.entryPoints) {
+      if (!outcome.foundEntryPoints.count(entryPoint)) {
+        llvm::errs() << "Could not locate definition of the target function '" << entryPoint << "'!\n";
+        status = 1;
+      }
+    }
+  }
+  if (request.scan) {
+    printScanReport(outcome.scans, llvm::outs());
+  }
+  if (!outcome.errors.empty()) {
+    llvm::errs() << outcome.errors.size() << " function(s) could not be translated and were skipped\n";
+    status = 1;
+  }
+  reportStats();
+  writeTrace();
+  return status;
 }
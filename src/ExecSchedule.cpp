@@ -7,44 +7,29 @@ namespace spf_ie {
 
 /* ExecSchedule */
 
-ExecSchedule::ExecSchedule(const ExecSchedule &other) {
-  scheduleTuple = other.scheduleTuple;
-}
-
 void ExecSchedule::pushValue(const ScheduleVal &value) {
-  scheduleTuple.push_back(std::make_shared<ScheduleVal>(value));
+  scheduleTuple.push_back(value);
 }
 
 ScheduleVal ExecSchedule::popValue() {
-  ScheduleVal value = *scheduleTuple.back();
-  scheduleTuple.pop_back();
-  return value;
+  return scheduleTuple.pop_back_val();
 }
 
 void ExecSchedule::advanceSchedule() {
-  if (scheduleTuple.empty() || scheduleTuple.back()->valueIsVar) {
-    scheduleTuple.push_back(std::make_shared<ScheduleVal>(0));
+  if (scheduleTuple.empty() || scheduleTuple.back().valueIsVar) {
+    scheduleTuple.push_back(ScheduleVal::makeNum(0));
   } else {
-    std::shared_ptr<ScheduleVal> top = scheduleTuple.back();
-    scheduleTuple.pop_back();
-    scheduleTuple.push_back(std::make_shared<ScheduleVal>(top->num + 1));
+    scheduleTuple.back().num++;
   }
 }
 
 void ExecSchedule::skipToPosition(unsigned int newPosition) {
-  std::shared_ptr<ScheduleVal> top = scheduleTuple.back();
-  if (top->valueIsVar) {
-    Utils::printErrorAndExit("Cannot skip to position " + std::to_string(newPosition) +
+  ScheduleVal &top = scheduleTuple.back();
+  if (top.valueIsVar) {
+    Utils::raiseError("Cannot skip to position " + std::to_string(newPosition) +
         ", because top of stack is not a number.");
   }
-  scheduleTuple.pop_back();
-  scheduleTuple.push_back(std::make_shared<ScheduleVal>(newPosition));
+  top.num = newPosition;
 }
 
-/* ScheduleVal */
-
-ScheduleVal::ScheduleVal(std::string var) : var(var), valueIsVar(true) {}
-
-ScheduleVal::ScheduleVal(int num) : num(num), valueIsVar(false) {}
-
 }  // namespace spf_ie
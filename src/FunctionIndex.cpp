@@ -0,0 +1,223 @@
+#include "FunctionIndex.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Driver.hpp"
+#include "Stats.hpp"
+#include "SummaryStore.hpp"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace spf_ie {
+
+namespace {
+
+//! Get the canonical type of a function as a string, to compare declarations
+//! and definitions from different translation units
+std::string getSignature(const FunctionDecl *funcDecl, const ASTContext &context) {
+  return context.getCanonicalType(funcDecl->getType()).getAsString();
+}
+
+llvm::Error makeIndexError(const std::string &message) {
+  return llvm::make_error<llvm::StringError>(message, llvm::inconvertibleErrorCode());
+}
+
+}  // namespace
+
+//! Adds the functions defined in each file parsed to an index
+class IndexingConsumer : public ASTConsumer {
+public:
+  IndexingConsumer(FunctionIndex &index, llvm::StringRef fileName)
+      : index(index), fileName(fileName.str()) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    for (auto it: Ctx.getTranslationUnitDecl()->decls()) {
+      auto *func = dyn_cast<FunctionDecl>(it);
+      // functions with internal linkage can't be called from other files,
+      // and those from headers are already visible to their callers
+      if (func && func->doesThisDeclarationHaveABody() && func->isExternallyVisible() &&
+          Ctx.getSourceManager().isInMainFile(func->getLocation())) {
+        index.addDefinition(func, fileName);
+      }
+    }
+  }
+
+private:
+  FunctionIndex &index;
+  std::string fileName;
+};
+
+namespace {
+
+class IndexingAction : public ASTFrontendAction {
+public:
+  explicit IndexingAction(FunctionIndex &index) : index(index) {}
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &Compiler, llvm::StringRef InFile) override {
+    return std::unique_ptr<ASTConsumer>(new IndexingConsumer(index, InFile));
+  }
+
+private:
+  FunctionIndex &index;
+};
+
+class IndexingActionFactory : public FrontendActionFactory {
+public:
+  explicit IndexingActionFactory(FunctionIndex &index) : index(index) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::unique_ptr<FrontendAction>(new IndexingAction(index));
+  }
+
+private:
+  FunctionIndex &index;
+};
+
+}  // namespace
+
+/* FunctionIndex */
+
+FunctionIndex::FunctionIndex(const CompilationDatabase &compilations) : compilations(compilations) {}
+
+int FunctionIndex::build(const std::vector<std::string> &files) {
+  llvm::TimeTraceScope timeScope("buildFunctionIndex");
+  ClangTool tool(compilations, files);
+  // problems in files are reported when (and if) they are translated
+  IgnoringDiagConsumer ignoreDiagnostics;
+  tool.setDiagnosticConsumer(&ignoreDiagnostics);
+  IndexingActionFactory actionFactory(*this);
+  return tool.run(&actionFactory);
+}
+
+llvm::Expected<FunctionIndex::Definition> FunctionIndex::findDefinition(const FunctionDecl *declaration) {
+  std::lock_guard<std::recursive_mutex> guard(mutex);
+  auto found = findEntry(declaration);
+  if (!found) {
+    return found.takeError();
+  }
+  Entry *match = *found;
+  if (!match) {
+    return Definition();
+  }
+
+  if (!match->definition.decl) {
+    ASTUnit *unit = getUnit(match->fileName);
+    if (!unit) {
+      return makeIndexError("Could not parse '" + match->fileName + "', which defines the called function");
+    }
+    std::string name = declaration->getQualifiedNameAsString();
+    ASTContext &unitContext = unit->getASTContext();
+    for (auto it: unitContext.getTranslationUnitDecl()->decls()) {
+      auto *func = dyn_cast<FunctionDecl>(it);
+      if (func && func->doesThisDeclarationHaveABody() && func->getQualifiedNameAsString() == name &&
+          getSignature(func, unitContext) == match->signature) {
+        match->definition.decl = func;
+        match->definition.context = &unitContext;
+        break;
+      }
+    }
+    if (!match->definition.decl) {
+      return makeIndexError("Called function is no longer defined in '" + match->fileName + "'");
+    }
+  }
+  return match->definition;
+}
+
+std::string FunctionIndex::getSummarySourceKey(const FunctionDecl *declaration) {
+  std::lock_guard<std::recursive_mutex> guard(mutex);
+  auto found = findEntry(declaration);
+  if (!found) {
+    // finding the definition will report the problem
+    llvm::consumeError(found.takeError());
+    return std::string();
+  }
+  return (*found ? (*found)->summarySourceKey : std::string());
+}
+
+size_t FunctionIndex::size() const {
+  size_t numDefinitions = 0;
+  for (const auto &it: entries) {
+    numDefinitions += it.second.size();
+  }
+  return numDefinitions;
+}
+
+llvm::Expected<FunctionIndex::Entry *> FunctionIndex::findEntry(const FunctionDecl *declaration) {
+  auto found = entries.find(declaration->getQualifiedNameAsString());
+  if (found == entries.end()) {
+    return nullptr;
+  }
+
+  // a declaration without a prototype, as in "int f();", matches any definition
+  std::string signature = getSignature(declaration, declaration->getASTContext());
+  Entry *match = nullptr;
+  for (auto &entry: found->second) {
+    if (!declaration->hasPrototype() || entry.signature == signature) {
+      if (match) {
+        return makeIndexError("Called function is defined in both '" + match->fileName + "' and '" +
+            entry.fileName + "'");
+      }
+      match = &entry;
+    }
+  }
+  if (!match) {
+    const Entry &other = found->second.front();
+    return makeIndexError("Called function is declared as '" + signature + "' but defined in '" + other.fileName +
+        "' as '" + other.signature + "'");
+  }
+  return match;
+}
+
+void FunctionIndex::addDefinition(const FunctionDecl *funcDecl, const std::string &fileName) {
+  Entry entry;
+  entry.fileName = fileName;
+  entry.signature = getSignature(funcDecl, funcDecl->getASTContext());
+  entry.summarySourceKey = SummaryStore::computeSourceKey(funcDecl);
+  entries[funcDecl->getQualifiedNameAsString()].push_back(std::move(entry));
+}
+
+ASTUnit *FunctionIndex::getUnit(const std::string &fileName) {
+  auto it = units.find(fileName);
+  if (it != units.end()) {
+    return it->second.get();
+  }
+  llvm::TimeTraceScope timeScope("parseForeignFile", fileName);
+  PhaseTimer parseTimer(Stats::Parse);
+  ClangTool tool(compilations, fileName);
+  std::vector<std::unique_ptr<ASTUnit>> asts;
+  std::unique_ptr<ASTUnit> unit;
+  if (!tool.buildASTs(asts) && asts.size() == 1) {
+    unit = std::move(asts.front());
+    Stats::increment(Stats::ForeignFilesParsed);
+  }
+  // failures are remembered too, so the file is only tried once
+  return (units[fileName] = std::move(unit)).get();
+}
+
+/* ForeignASTScope */
+
+ForeignASTScope::ForeignASTScope(FunctionIndex &index, const FunctionIndex::Definition &definition)
+    : lock(index.mutex), outerContext(Context) {
+  Context = definition.context;
+}
+
+ForeignASTScope::~ForeignASTScope() {
+  Context = outerContext;
+}
+
+}  // namespace spf_ie
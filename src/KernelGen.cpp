@@ -0,0 +1,77 @@
+/*!
+ * \file KernelGen.cpp
+ *
+ * \brief Command-line tool writing a synthetic kernel of a given shape, for
+ * feeding to spf-ie when measuring how it scales.
+ */
+
+#include <string>
+#include <system_error>
+
+#include "KernelGenerator.hpp"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace spf_ie;
+
+static llvm::cl::OptionCategory KernelGenCategory("spf-ie-kernelgen options");
+
+static llvm::cl::opt<unsigned> NumStmts(
+    "stmts", llvm::cl::desc("Number of statements in the innermost loop"),
+    llvm::cl::init(1), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<unsigned> LoopDepth(
+    "depth", llvm::cl::desc("Depth of the loop nest"),
+    llvm::cl::init(1), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<unsigned> NumIfGuards(
+    "ifs", llvm::cl::desc("Number of nested if statements around the innermost statements"),
+    llvm::cl::init(0), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<unsigned> CallFanOut(
+    "calls", llvm::cl::desc("Number of helper function calls in the innermost loop"),
+    llvm::cl::init(0), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<unsigned> InliningDepth(
+    "inline-depth", llvm::cl::desc("Length of the chain of helper functions behind each call"),
+    llvm::cl::init(1), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<unsigned> ArrayDim(
+    "array-dim", llvm::cl::desc("Dimensionality of the arrays accessed"),
+    llvm::cl::init(1), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<std::string> FunctionName(
+    "name", llvm::cl::desc("Name of the kernel function"),
+    llvm::cl::init("kernel"), llvm::cl::cat(KernelGenCategory));
+
+static llvm::cl::opt<std::string> OutputFile(
+    "o", llvm::cl::desc("Write the kernel to this file instead of standard output"),
+    llvm::cl::value_desc("file"), llvm::cl::cat(KernelGenCategory));
+
+int main(int argc, const char **argv) {
+  llvm::cl::HideUnrelatedOptions(KernelGenCategory);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Synthetic kernel generator for spf-ie\n");
+
+  KernelShape shape;
+  shape.numStmts = NumStmts;
+  shape.loopDepth = LoopDepth;
+  shape.numIfGuards = NumIfGuards;
+  shape.callFanOut = CallFanOut;
+  shape.inliningDepth = InliningDepth;
+  shape.arrayDim = ArrayDim;
+  std::string code = KernelGenerator::generate(shape, FunctionName);
+
+  if (OutputFile.empty()) {
+    llvm::outs() << code;
+    return 0;
+  }
+  std::error_code error;
+  llvm::raw_fd_ostream file(OutputFile, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "ERROR: Could not open '" << OutputFile << "': " << error.message() << "\n";
+    return 1;
+  }
+  file << code;
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include "KernelGenerator.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "DataAccessHandler.hpp"
+
+namespace spf_ie {
+
+namespace {
+
+//! Name of the iterator of the loop at the given depth
+std::string iterName(unsigned int depth) {
+  return "i" + std::to_string(depth);
+}
+
+//! Name of the helper function at the given level of the call chain
+std::string helperName(const std::string &kernelName, unsigned int level) {
+  return kernelName + "_helper" + std::to_string(level);
+}
+
+}  // namespace
+
+/* KernelGenerator */
+
+std::string KernelGenerator::generate(const KernelShape &shape, const std::string &name) {
+  const unsigned int loopDepth = std::max(1u, shape.loopDepth);
+  const unsigned int arrayDim = std::min(std::max(1u, shape.arrayDim), (unsigned int) MAX_ARRAY_DIM);
+  const unsigned int inliningDepth = std::max(1u, shape.inliningDepth);
+  std::ostringstream code;
+
+  // helper functions, each calling the next one down the chain, defined
+  // deepest first so that no prototypes are needed
+  if (shape.callFanOut > 0) {
+    for (unsigned int level = inliningDepth; level-- > 0;) {
+      std::string suffix = std::to_string(level);
+      code << "double " << helperName(name, level) << "(double x" << suffix << ") {\n"
+           << "  double y" << suffix << " = x" << suffix << " * 2;\n";
+      if (level + 1 < inliningDepth) {
+        code << "  double z" << suffix << " = " << helperName(name, level + 1) << "(y" << suffix << ");\n"
+             << "  return z" << suffix << ";\n";
+      } else {
+        code << "  return y" << suffix << ";\n";
+      }
+      code << "}\n\n";
+    }
+  }
+
+  // arrays are square, with one extent per dimension
+  std::string arrayExtents;
+  for (unsigned int d = 0; d < arrayDim; ++d) {
+    arrayExtents += "[N]";
+  }
+  code << "void " << name << "(int N, double A" << arrayExtents << ", double B" << arrayExtents << ") {\n";
+
+  // array subscripts use the innermost iterators, repeating the outermost
+  // one if there are more dimensions than loops
+  std::string subscripts;
+  for (unsigned int d = 0; d < arrayDim; ++d) {
+    int loop = (int) loopDepth - (int) arrayDim + (int) d;
+    subscripts += "[" + iterName(std::max(0, loop)) + "]";
+  }
+
+  std::string indent = "  ";
+  for (unsigned int d = 0; d < loopDepth; ++d) {
+    code << indent << "for (int " << iterName(d) << " = 0; " << iterName(d) << " < N; " << iterName(d) << "++) {\n";
+    indent += "  ";
+  }
+  for (unsigned int g = 0; g < shape.numIfGuards; ++g) {
+    code << indent << "if (" << iterName(g % loopDepth) << " < N - " << (g + 1) << ") {\n";
+    indent += "  ";
+  }
+
+  for (unsigned int s = 0; s < shape.numStmts; ++s) {
+    code << indent << "A" << subscripts << " = A" << subscripts << " + B" << subscripts << " * " << s << ";\n";
+  }
+  for (unsigned int c = 0; c < shape.callFanOut; ++c) {
+    std::string suffix = std::to_string(c);
+    code << indent << "double a" << suffix << " = B" << subscripts << ";\n"
+         << indent << "double r" << suffix << " = " << helperName(name, 0) << "(a" << suffix << ");\n"
+         << indent << "A" << subscripts << " = A" << subscripts << " + r" << suffix << ";\n";
+  }
+
+  for (unsigned int d = 0; d < loopDepth + shape.numIfGuards; ++d) {
+    indent.resize(indent.size() - 2);
+    code << indent << "}\n";
+  }
+  code << "}\n";
+  return code.str();
+}
+
+}  // namespace spf_ie
@@ -3,13 +3,15 @@
 #include <memory>
 #include <sstream>
 #include <string>
-#include <tuple>
 #include <vector>
 #include <algorithm>
 
+#include "BuildContext.hpp"
 #include "DataAccessHandler.hpp"
 #include "Driver.hpp"
 #include "ExecSchedule.hpp"
+#include "SPFPrinter.hpp"
+#include "Stats.hpp"
 #include "Utils.hpp"
 #include "iegenlib.h"
 #include "clang/AST/Decl.h"
@@ -21,43 +23,106 @@ using namespace clang;
 
 namespace spf_ie {
 
+namespace {
+
+//! Make a tuple declaration with the given iterators as its leading elements
+//! (or a single constant 0 if there are none), leaving room for outArity more
+iegenlib::TupleDecl makeItersTupleDecl(const std::vector<std::string> &iterators, unsigned int outArity = 0) {
+  unsigned int inArity = iterators.empty() ? 1 : iterators.size();
+  iegenlib::TupleDecl tupleDecl(inArity + outArity);
+  if (iterators.empty()) {
+    tupleDecl.setTupleElem(0, 0);
+  } else {
+    for (unsigned int i = 0; i < iterators.size(); ++i) {
+      tupleDecl.setTupleElem(i, iterators[i]);
+    }
+  }
+  return tupleDecl;
+}
+
+//! Make an expression which is just the tuple variable at the given location
+std::unique_ptr<iegenlib::Exp> makeTupleVarExp(int location, int coeff = 1) {
+  auto exp = std::unique_ptr<iegenlib::Exp>(new iegenlib::Exp());
+  exp->addTerm(new iegenlib::TupleVarTerm(coeff, location));
+  return exp;
+}
+
+//! Add the constraint "lower oper upper" to a conjunction, written as
+//! IEGenLib stores it: an equality or inequality against zero
+//! \return false if the operator is not a supported comparison
+bool addComparison(iegenlib::Conjunction &conjunction, std::unique_ptr<iegenlib::Exp> lower,
+                   std::unique_ptr<iegenlib::Exp> upper, BinaryOperatorKind oper) {
+  // everything is moved to one side: lower - upper (op) 0
+  switch (oper) {
+  case BO_LT:
+  case BO_LE:
+    // upper - lower (- 1) >= 0
+    lower->multiplyBy(-1);
+    upper->addExp(lower.release());
+    if (oper == BO_LT) {
+      upper->addTerm(new iegenlib::Term(-1));
+    }
+    conjunction.addInequality(upper.release());
+    return true;
+  case BO_GT:
+  case BO_GE:
+    // lower - upper (- 1) >= 0
+    upper->multiplyBy(-1);
+    lower->addExp(upper.release());
+    if (oper == BO_GT) {
+      lower->addTerm(new iegenlib::Term(-1));
+    }
+    conjunction.addInequality(lower.release());
+    return true;
+  case BO_EQ:
+    upper->multiplyBy(-1);
+    lower->addExp(upper.release());
+    conjunction.addEquality(lower.release());
+    return true;
+  default:
+    return false;
+  }
+}
+
+}  // namespace
+
 /* PositionContext */
 
-PositionContext::PositionContext() = default;
+PositionContext::PositionContext(BuildContext *build) : build(build) {
+  auto topLevel = std::make_shared<Level>();
+  topLevel->itersTupleString = "[0]";
+  level = std::move(topLevel);
+}
+
+unsigned int PositionContext::getNestLevel() const {
+  return level->nestLevel;
+}
 
 std::string PositionContext::getIterSpaceString() {
-  std::ostringstream os;
-  os << "{" << getItersTupleString();
-  if (!constraints.empty()) {
-    os << ": ";
-    for (const auto &it: constraints) {
-      if (it != *constraints.begin()) {
-        os << " and ";
-      }
-      os << std::get<0>(*it) << " "
-         << Utils::binaryOperatorKindToString(std::get<2>(*it)) << " "
-         << std::get<1>(*it);
-    }
+  PhaseTimer timer(Stats::PositionStrings);
+  if (level->constraintsString.empty()) {
+    return "{" + level->itersTupleString + "}";
   }
-  os << "}";
-  return os.str();
+  return "{" + level->itersTupleString + ": " + level->constraintsString + "}";
 }
 
 std::string PositionContext::getExecScheduleString() {
+  PhaseTimer timer(Stats::PositionStrings);
   std::ostringstream os;
-  os << "{" << getItersTupleString() << "->[";
-  if (schedule.scheduleTuple.empty()) {
+  os << "{" << level->itersTupleString << "->[";
+  if (level->schedulePrefix.scheduleTuple.empty() && schedule.scheduleTuple.empty()) {
     os << "0";
   } else {
-    for (const auto &it: schedule.scheduleTuple) {
-      if (it != *schedule.scheduleTuple.begin()) {
+    // only the values past the enclosing loops' part of the schedule vary
+    // from statement to statement
+    os << level->schedulePrefixString;
+    bool first = level->schedulePrefix.scheduleTuple.empty();
+    for (const auto &value: schedule.scheduleTuple) {
+      if (!first) {
         os << ",";
       }
-      if (it->valueIsVar) {
-        os << it->var;
-      } else {
-        os << it->num;
-      }
+      first = false;
+      appendScheduleVal(os, value);
     }
   }
   os << "]}";
@@ -65,10 +130,19 @@ std::string PositionContext::getExecScheduleString() {
 }
 
 std::string PositionContext::getDataAccessString(DataAccess *access) {
+  PhaseTimer timer(Stats::PositionStrings);
   std::ostringstream os;
   std::vector<std::pair<std::string, std::string>> constraintsToAdd;
-  os << "{" << getItersTupleString() << "->[";
-  if (access->indexes.empty()) {
+  os << "{" << level->itersTupleString << "->[";
+  if (access->wholeArrayDims > 0) {
+    // any element at all, through unconstrained replacement variables
+    for (unsigned int i = 0; i < access->wholeArrayDims; ++i) {
+      if (i > 0) {
+        os << ",";
+      }
+      os << build->getVarReplacementName();
+    }
+  } else if (access->indexes.empty()) {
     os << "0";
   } else {
     for (const auto &it: access->indexes) {
@@ -76,20 +150,20 @@ std::string PositionContext::getDataAccessString(DataAccess *access) {
         os << ",";
       }
       if (isa<DeclRefExpr>(it->IgnoreParenImpCasts())) {
-        os << Utils::stmtToString(it);
+        os << Utils::stmtToString(it).str();
       } else {
         std::vector<Expr *> subAccesses;
         Utils::collectComponentsFromCompoundExpr(it, subAccesses);
         if (!subAccesses.empty()) {
-          std::string replacementName = Utils::getVarReplacementName();
+          std::string replacementName = build->getVarReplacementName();
           os << replacementName;
           constraintsToAdd.emplace_back(replacementName, exprToStringWithSafeArrays(it));
         } else {
           // if the expression is not a nested access or single variable
           // simply assign it to a replacement variable and use that
-          std::string replacementName = Utils::getVarReplacementName();
+          std::string replacementName = build->getVarReplacementName();
           os << replacementName;
-          constraintsToAdd.emplace_back(replacementName, Utils::stmtToString(it));
+          constraintsToAdd.emplace_back(replacementName, Utils::stmtToString(it).str());
         }
       }
     }
@@ -108,11 +182,146 @@ std::string PositionContext::getDataAccessString(DataAccess *access) {
   return os.str();
 }
 
-bool PositionContext::isIteratorName(const std::string &varName) {
-  return std::count(iterators.begin(), iterators.end(), varName);
+std::unique_ptr<iegenlib::Set> PositionContext::makeIterSpace() const {
+  PhaseTimer timer(Stats::PositionSets);
+  // the iteration space is the same for every statement at this level, so
+  // it is built once and copied
+  if (!level->iterSpaceBuilt) {
+    level->iterSpace = buildIterSpace();
+    level->iterSpaceBuilt = true;
+  }
+  if (!level->iterSpace) {
+    return nullptr;
+  }
+  return std::unique_ptr<iegenlib::Set>(new iegenlib::Set(*level->iterSpace));
+}
+
+std::unique_ptr<iegenlib::Set> PositionContext::buildIterSpace() const {
+  const auto &iterators = level->iterators;
+  int arity = iterators.empty() ? 1 : iterators.size();
+  auto conjunction = std::unique_ptr<iegenlib::Conjunction>(new iegenlib::Conjunction(arity));
+  conjunction->setTupleDecl(makeItersTupleDecl(iterators));
+  for (const auto &constraint: level->constraints) {
+    auto lower = constraint.lower ? makeExp(constraint.lower)
+                                  : makeVarExp(build->symbols.getName(constraint.lowerVar));
+    auto upper = makeExp(constraint.upper);
+    if (!lower || !upper
+        || !addComparison(*conjunction, std::move(lower), std::move(upper), constraint.oper)) {
+      return nullptr;
+    }
+  }
+  auto set = std::unique_ptr<iegenlib::Set>(new iegenlib::Set(arity));
+  set->addConjunction(conjunction.release());
+  set->cleanUp();
+  return set;
+}
+
+std::unique_ptr<iegenlib::Relation> PositionContext::makeExecSchedule() const {
+  PhaseTimer timer(Stats::PositionSets);
+  const auto &iterators = level->iterators;
+  llvm::SmallVector<ScheduleVal, 16> scheduleTuple(level->schedulePrefix.scheduleTuple);
+  scheduleTuple.append(schedule.scheduleTuple.begin(), schedule.scheduleTuple.end());
+  int inArity = iterators.empty() ? 1 : iterators.size();
+  int outArity = scheduleTuple.empty() ? 1 : scheduleTuple.size();
+  auto conjunction = std::unique_ptr<iegenlib::Conjunction>(
+      new iegenlib::Conjunction(inArity + outArity, inArity));
+  iegenlib::TupleDecl tupleDecl = makeItersTupleDecl(iterators, outArity);
+  if (scheduleTuple.empty()) {
+    tupleDecl.setTupleElem(inArity, 0);
+  }
+  for (unsigned int i = 0; i < scheduleTuple.size(); ++i) {
+    const auto &value = scheduleTuple[i];
+    if (!value.valueIsVar) {
+      tupleDecl.setTupleElem(inArity + i, value.num);
+      continue;
+    }
+    llvm::StringRef varName = build->symbols.getName(value.var);
+    int iterPosition = getIteratorPosition(varName);
+    if (iterPosition < 0) {
+      return nullptr;
+    }
+    // an iterator repeated in the output tuple is equal to its input
+    tupleDecl.setTupleElem(inArity + i, varName.str());
+    auto equality = makeTupleVarExp(iterPosition);
+    equality->addExp(makeTupleVarExp(inArity + i, -1).release());
+    conjunction->addEquality(equality.release());
+  }
+  conjunction->setTupleDecl(tupleDecl);
+  auto relation = std::unique_ptr<iegenlib::Relation>(new iegenlib::Relation(inArity, outArity));
+  relation->addConjunction(conjunction.release());
+  relation->cleanUp();
+  return relation;
+}
+
+std::unique_ptr<iegenlib::Relation> PositionContext::makeDataAccessRelation(const DataAccess &access) {
+  PhaseTimer timer(Stats::PositionSets);
+  // convert every index before taking any replacement names, so that falling
+  // back to the string form numbers them the same
+  std::vector<std::unique_ptr<iegenlib::Exp>> indexExps;
+  for (const auto &index: access.indexes) {
+    if (isa<DeclRefExpr>(index->IgnoreParenImpCasts())) {
+      indexExps.emplace_back(nullptr);
+    } else if (auto indexExp = makeExp(index)) {
+      indexExps.push_back(std::move(indexExp));
+    } else {
+      return nullptr;
+    }
+  }
+
+  const auto &iterators = level->iterators;
+  int inArity = iterators.empty() ? 1 : iterators.size();
+  int outArity = access.wholeArrayDims > 0 ? access.wholeArrayDims :
+                 access.indexes.empty() ? 1 : access.indexes.size();
+  auto conjunction = std::unique_ptr<iegenlib::Conjunction>(
+      new iegenlib::Conjunction(inArity + outArity, inArity));
+  iegenlib::TupleDecl tupleDecl = makeItersTupleDecl(iterators, outArity);
+  if (access.wholeArrayDims > 0) {
+    // any element at all, through unconstrained replacement variables
+    for (unsigned int i = 0; i < access.wholeArrayDims; ++i) {
+      tupleDecl.setTupleElem(inArity + i, build->getVarReplacementName());
+    }
+  } else if (access.indexes.empty()) {
+    tupleDecl.setTupleElem(inArity, 0);
+  }
+  for (unsigned int i = 0; i < access.indexes.size(); ++i) {
+    int location = inArity + i;
+    if (!indexExps[i]) {
+      // a plain variable names the output tuple element, and is tied to the
+      // input when it is an iterator
+      std::string varName = Utils::stmtToString(access.indexes[i]).str();
+      tupleDecl.setTupleElem(location, varName);
+      int iterPosition = getIteratorPosition(varName);
+      if (iterPosition >= 0) {
+        auto equality = makeTupleVarExp(iterPosition);
+        equality->addExp(makeTupleVarExp(location, -1).release());
+        conjunction->addEquality(equality.release());
+      }
+    } else {
+      // anything else is assigned to a replacement variable
+      tupleDecl.setTupleElem(location, build->getVarReplacementName());
+      auto equality = makeTupleVarExp(location);
+      indexExps[i]->multiplyBy(-1);
+      equality->addExp(indexExps[i].release());
+      conjunction->addEquality(equality.release());
+    }
+  }
+  conjunction->setTupleDecl(tupleDecl);
+  auto relation = std::unique_ptr<iegenlib::Relation>(new iegenlib::Relation(inArity, outArity));
+  relation->addConjunction(conjunction.release());
+  relation->cleanUp();
+  return relation;
+}
+
+bool PositionContext::isIteratorName(llvm::StringRef varName) const {
+  return level->iteratorSet.contains(lookupSymbol(varName));
+}
+
+bool PositionContext::isInvariant(llvm::StringRef dataSpaceName) const {
+  return level->invariants.contains(lookupSymbol(dataSpaceName));
 }
 
 void PositionContext::enterFor(ForStmt *forStmt) {
+  std::shared_ptr<Level> next = makeNestedLevel();
   std::string error;
   std::string errorReason;
 
@@ -120,13 +329,13 @@ void PositionContext::enterFor(ForStmt *forStmt) {
   std::string initVar;
   if (auto *originalInit = forStmt->getInit()) {
     if (auto *init = dyn_cast<BinaryOperator>(originalInit)) {
-      makeAndInsertConstraint(init->getLHS(), init->getRHS(),
+      makeAndInsertConstraint(*next, init->getLHS(), init->getRHS(),
                               BinaryOperatorKind::BO_GE);
-      initVar = Utils::stmtToString(init->getLHS());
+      initVar = Utils::stmtToString(init->getLHS()).str();
     } else if (auto *init = dyn_cast<DeclStmt>(originalInit)) {
       if (init->isSingleDecl()) {
         if (auto *initDecl = dyn_cast<VarDecl>(init->getSingleDecl())) {
-          makeAndInsertConstraint(initDecl->getNameAsString(),
+          makeAndInsertConstraint(*next, initDecl->getNameAsString(),
                                   initDecl->getInit(),
                                   BinaryOperatorKind::BO_GE);
           initVar = initDecl->getNameAsString();
@@ -151,23 +360,20 @@ void PositionContext::enterFor(ForStmt *forStmt) {
   // condition
   if (auto *originalCond = forStmt->getCond()) {
     if (auto *cond = dyn_cast<BinaryOperator>(originalCond)) {
-      makeAndInsertConstraint(cond->getLHS(), cond->getRHS(),
+      makeAndInsertConstraint(*next, cond->getLHS(), cond->getRHS(),
                               cond->getOpcode());
       // add any data spaces accessed in the condition to loop invariants
-      std::vector<std::string> newInvariants;
       std::vector<Expr *> accessExprs;
       Utils::collectComponentsFromCompoundExpr(cond->getLHS(), accessExprs);
       Utils::collectComponentsFromCompoundExpr(cond->getRHS(), accessExprs);
       std::vector<DataAccess> accesses;
       for (const auto &accessExpr: accessExprs) {
-        auto additionalAccesses = DataAccessHandler::makeDataAccessesFromExpr(accessExpr, true);
+        auto additionalAccesses = DataAccessHandler::makeDataAccessesFromExpr(accessExpr, true, *this);
         accesses.insert(accesses.end(), additionalAccesses.begin(), additionalAccesses.end());
       }
       for (const auto &access: accesses) {
-        newInvariants.push_back(
-            access.name);
+        next->invariants.insert(build->symbols.intern(access.name));
       }
-      invariants.push_back(newInvariants);
     } else {
       error = "condition";
       errorReason = "must be a binary operation";
@@ -201,13 +407,13 @@ void PositionContext::enterFor(ForStmt *forStmt) {
         // (e.g. with i = i + 1, this is i + 1)
         auto *secondOp = cast<BinaryOperator>(incOper->getRHS());
         // Get variable being incremented
-        std::string iterStr = Utils::stmtToString(incOper->getLHS());
+        llvm::StringRef iterStr = Utils::stmtToString(incOper->getLHS());
         if (secondOp->getOpcode() == BO_Add) {
           // Get our lh and rh expression, also in string form
           Expr *lhs = secondOp->getLHS();
           Expr *rhs = secondOp->getRHS();
-          std::string lhsStr = Utils::stmtToString(lhs);
-          std::string rhsStr = Utils::stmtToString(rhs);
+          llvm::StringRef lhsStr = Utils::stmtToString(lhs);
+          llvm::StringRef rhsStr = Utils::stmtToString(rhs);
           Expr::EvalResult result;
           // one side must be iter var, other must be 1
           validIncrement = (lhsStr == iterStr &&
@@ -229,93 +435,248 @@ void PositionContext::enterFor(ForStmt *forStmt) {
   }
 
   if (!error.empty()) {
-    Utils::printErrorAndExit(
+    Utils::raiseError(
         "Invalid " + error + " in for loop -- " + errorReason, forStmt);
   } else {
-    iterators.push_back(initVar);
-    schedule.pushValue(ScheduleVal(initVar));
-    nestLevel++;
+    SymbolId iterator = build->symbols.intern(initVar);
+    next->iterators.push_back(initVar);
+    next->iteratorSet.insert(iterator);
+    // the loop's position and iterator become fixed for everything inside it
+    next->outerSchedule = schedule;
+    for (const auto &value: schedule.scheduleTuple) {
+      next->schedulePrefix.pushValue(value);
+    }
+    next->schedulePrefix.pushValue(ScheduleVal::makeVar(iterator));
+    schedule = ExecSchedule();
+    enterLevel(std::move(next));
   }
 }
 
 void PositionContext::exitFor() {
-  constraints.pop_back();
-  constraints.pop_back();
-  iterators.pop_back();
-  schedule.popValue();
-  schedule.popValue();
-  invariants.pop_back();
-  nestLevel--;
+  schedule = level->outerSchedule;
+  level = level->parent;
 }
 
 void PositionContext::enterIf(IfStmt *ifStmt, bool invert) {
+  std::shared_ptr<Level> next = makeNestedLevel();
   if (auto *cond = dyn_cast<BinaryOperator>(ifStmt->getCond())) {
     makeAndInsertConstraint(
-        cond->getLHS(), cond->getRHS(),
+        *next, cond->getLHS(), cond->getRHS(),
         (invert ? BinaryOperator::negateComparisonOp(cond->getOpcode())
                 : cond->getOpcode()));
   } else {
-    Utils::printErrorAndExit(
+    Utils::raiseError(
         "If statement condition must be a binary operation", ifStmt);
   }
-  nestLevel++;
+  // statements inside an if are numbered on from those before it
+  enterLevel(std::move(next));
 }
 
 void PositionContext::exitIf() {
-  constraints.pop_back();
-  nestLevel--;
+  level = level->parent;
 }
 
-void PositionContext::makeAndInsertConstraint(Expr *lower, Expr *upper,
+std::shared_ptr<PositionContext::Level> PositionContext::makeNestedLevel() const {
+  auto next = std::make_shared<Level>(*level);
+  next->parent = level;
+  next->nestLevel++;
+  next->iterSpace.reset();
+  next->iterSpaceBuilt = false;
+  return next;
+}
+
+void PositionContext::makeAndInsertConstraint(Level &target, Expr *lower, Expr *upper,
                                               BinaryOperatorKind oper) {
-  makeAndInsertConstraint(exprToStringWithSafeArrays(lower), upper, oper);
+  insertConstraint(target, {lower, SymbolTable::NoSymbol, upper, oper});
 }
 
-void PositionContext::makeAndInsertConstraint(std::string lower, Expr *upper,
+void PositionContext::makeAndInsertConstraint(Level &target, const std::string &lowerVar, Expr *upper,
                                               BinaryOperatorKind oper) {
-  if (oper == BinaryOperatorKind::BO_NE) {
-    Utils::printErrorAndExit(
+  insertConstraint(target, {nullptr, build->symbols.intern(lowerVar), upper, oper});
+}
+
+void PositionContext::insertConstraint(Level &target, const Constraint &constraint) {
+  if (constraint.oper == BinaryOperatorKind::BO_NE) {
+    std::string lower = constraint.lower ? exprToStringWithSafeArrays(constraint.lower)
+                                         : build->symbols.getName(constraint.lowerVar).str();
+    Utils::raiseError(
         "Not-equal conditions are unsupported by SPF: in condition " +
-            lower + " != " + Utils::stmtToString(upper),
-        upper);
+            lower + " != " + Utils::stmtToString(constraint.upper).str(),
+        constraint.upper);
   }
-  constraints.push_back(
-      std::make_shared<
-          std::tuple<std::string, std::string, BinaryOperatorKind>>(
-          lower, exprToStringWithSafeArrays(upper), oper));
+  target.constraints.push_back(constraint);
+}
+
+std::string PositionContext::constraintToString(const Constraint &constraint) const {
+  std::string lower = constraint.lower ? exprToStringWithSafeArrays(constraint.lower)
+                                       : build->symbols.getName(constraint.lowerVar).str();
+  return lower + " " + Utils::binaryOperatorKindToString(constraint.oper) + " " +
+      exprToStringWithSafeArrays(constraint.upper);
 }
 
-std::string PositionContext::exprToStringWithSafeArrays(Expr *expr) {
-  std::string initialStr = Utils::stmtToString(expr);
+std::string PositionContext::exprToStringWithSafeArrays(Expr *expr) const {
+  std::string printed;
+  if (SPFPrinter::print(expr, true, nullptr, printed)) {
+    return printed;
+  }
+  // the printer cannot place code from macros; substitute in the text instead
+  std::string initialStr = Utils::stmtToString(expr).str();
   std::vector<Expr *> rawAccesses;
   Utils::collectComponentsFromCompoundExpr(expr, rawAccesses);
   for (const auto &access: rawAccesses) {
     if (isa<DeclRefExpr>(access)) {
       continue;
     }
-    auto accesses = DataAccessHandler::makeDataAccessesFromExpr(access, true);
+    auto accesses = DataAccessHandler::makeDataAccessesFromExpr(access, true, *this);
     std::string accessStr = accesses.back().toString(accesses);
     initialStr = iegenlib::replaceInString(
-        initialStr, Utils::stmtToString(access), accessStr);
+        initialStr, Utils::stmtToString(access).str(), accessStr);
+    Stats::increment(Stats::ReplaceInStringCalls);
   }
   return initialStr;
 }
 
-std::string PositionContext::getItersTupleString() {
-  std::ostringstream os;
-  os << "[";
-  if (iterators.empty()) {
-    os << "0";
+void PositionContext::enterLevel(std::shared_ptr<Level> next) {
+  // the strings are extended from the enclosing level's, which next started
+  // out as a copy of
+  const Level &parent = *level;
+
+  if (next->iterators.size() != parent.iterators.size()) {
+    std::ostringstream itersTuple;
+    itersTuple << "[";
+    for (const auto &it: next->iterators) {
+      if (&it != &next->iterators.front()) {
+        itersTuple << ",";
+      }
+      itersTuple << it;
+    }
+    itersTuple << "]";
+    next->itersTupleString = itersTuple.str();
+  }
+
+  std::ostringstream newConstraints;
+  for (unsigned int i = parent.constraints.size(); i < next->constraints.size(); ++i) {
+    if (i != 0) {
+      newConstraints << " and ";
+    }
+    newConstraints << constraintToString(next->constraints[i]);
+  }
+  next->constraintsString += newConstraints.str();
+
+  const auto &newPrefix = next->schedulePrefix.scheduleTuple;
+  std::ostringstream newSchedule;
+  for (unsigned int i = parent.schedulePrefix.scheduleTuple.size(); i < newPrefix.size(); ++i) {
+    if (i != 0) {
+      newSchedule << ",";
+    }
+    appendScheduleVal(newSchedule, newPrefix[i]);
+  }
+  next->schedulePrefixString += newSchedule.str();
+
+  level = std::move(next);
+}
+
+void PositionContext::appendScheduleVal(std::ostream &os, const ScheduleVal &value) const {
+  if (value.valueIsVar) {
+    os << build->symbols.getName(value.var).str();
   } else {
-    for (const auto &it: iterators) {
-      if (it != *iterators.begin()) {
-        os << ",";
+    os << value.num;
+  }
+}
+
+SymbolId PositionContext::lookupSymbol(llvm::StringRef name) const {
+  return build->symbols.lookup(name);
+}
+
+int PositionContext::getIteratorPosition(llvm::StringRef varName) const {
+  if (!isIteratorName(varName)) {
+    return -1;
+  }
+  const auto &iterators = level->iterators;
+  auto it = std::find(iterators.begin(), iterators.end(), varName);
+  return it == iterators.end() ? -1 : it - iterators.begin();
+}
+
+std::unique_ptr<iegenlib::Exp> PositionContext::makeExp(Expr *expr) const {
+  Expr *plainExpr = expr->IgnoreParenImpCasts();
+  auto exp = std::unique_ptr<iegenlib::Exp>(new iegenlib::Exp());
+  if (auto *asIntegerLiteral = dyn_cast<IntegerLiteral>(plainExpr)) {
+    exp->addTerm(new iegenlib::Term((int) asIntegerLiteral->getValue().getSExtValue()));
+  } else if (isa<DeclRefExpr>(plainExpr)) {
+    return makeVarExp(Utils::stmtToString(plainExpr));
+  } else if (auto *asArrayAccess = dyn_cast<ArraySubscriptExpr>(plainExpr)) {
+    // A[i][j] becomes the call A(i,j), with indexes innermost-last
+    std::vector<Expr *> indexes;
+    Expr *base = asArrayAccess;
+    while (auto *baseArrayAccess = dyn_cast<ArraySubscriptExpr>(base)) {
+      indexes.insert(indexes.begin(), baseArrayAccess->getIdx());
+      base = baseArrayAccess->getBase()->IgnoreParenImpCasts();
+    }
+    if (!isa<DeclRefExpr>(base)) {
+      return nullptr;
+    }
+    auto *call = new iegenlib::UFCallTerm(1, Utils::stmtToString(base).str(), indexes.size());
+    exp->addTerm(call);
+    for (unsigned int i = 0; i < indexes.size(); ++i) {
+      auto indexExp = makeExp(indexes[i]);
+      if (!indexExp) {
+        return nullptr;
       }
-      os << it;
+      call->setParamExp(i, indexExp.release());
     }
+  } else if (auto *asUnaryOper = dyn_cast<UnaryOperator>(plainExpr)) {
+    if (asUnaryOper->getOpcode() != UO_Minus && asUnaryOper->getOpcode() != UO_Plus) {
+      return nullptr;
+    }
+    exp = makeExp(asUnaryOper->getSubExpr());
+    if (exp && asUnaryOper->getOpcode() == UO_Minus) {
+      exp->multiplyBy(-1);
+    }
+  } else if (auto *asBinOper = dyn_cast<BinaryOperator>(plainExpr)) {
+    BinaryOperatorKind oper = asBinOper->getOpcode();
+    if (oper == BO_Mul) {
+      // only multiplication by a constant is affine
+      Expr *lhs = asBinOper->getLHS()->IgnoreParenImpCasts();
+      Expr *rhs = asBinOper->getRHS()->IgnoreParenImpCasts();
+      if (isa<IntegerLiteral>(lhs)) {
+        std::swap(lhs, rhs);
+      }
+      auto *factor = dyn_cast<IntegerLiteral>(rhs);
+      if (!factor) {
+        return nullptr;
+      }
+      exp = makeExp(lhs);
+      if (exp) {
+        exp->multiplyBy((int) factor->getValue().getSExtValue());
+      }
+    } else if (oper == BO_Add || oper == BO_Sub) {
+      exp = makeExp(asBinOper->getLHS());
+      auto rhsExp = makeExp(asBinOper->getRHS());
+      if (!exp || !rhsExp) {
+        return nullptr;
+      }
+      if (oper == BO_Sub) {
+        rhsExp->multiplyBy(-1);
+      }
+      exp->addExp(rhsExp.release());
+    } else {
+      return nullptr;
+    }
+  } else {
+    return nullptr;
   }
-  os << "]";
-  return os.str();
+  return exp;
+}
+
+std::unique_ptr<iegenlib::Exp> PositionContext::makeVarExp(llvm::StringRef name) const {
+  auto exp = std::unique_ptr<iegenlib::Exp>(new iegenlib::Exp());
+  int iterPosition = getIteratorPosition(name);
+  if (iterPosition >= 0) {
+    exp->addTerm(new iegenlib::TupleVarTerm(1, iterPosition));
+  } else {
+    exp->addTerm(new iegenlib::VarTerm(1, name.str()));
+  }
+  return exp;
 }
 
 }  // namespace spf_ie
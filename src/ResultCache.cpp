@@ -0,0 +1,147 @@
+#include "ResultCache.hpp"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "BuildId.hpp"
+#include "FunctionIndex.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+namespace {
+
+//! Collects the functions directly called from a function body
+class CalleeCollector : public RecursiveASTVisitor<CalleeCollector> {
+public:
+  bool VisitCallExpr(CallExpr *callExpr) {
+    if (const auto *callee = callExpr->getDirectCallee()) {
+      callees.push_back(callee);
+    }
+    return true;
+  }
+
+  std::vector<const FunctionDecl *> callees;
+};
+
+//! Add a component to a hash, delimited so that adjacent components can't run together
+void addToHash(llvm::SHA1 &hash, llvm::StringRef component) {
+  hash.update(component);
+  hash.update(llvm::StringRef("\0", 1));
+}
+
+//! Print a function declaration as Clang sees it, which reflects macro expansion and included code
+std::string printFunction(const FunctionDecl *funcDecl) {
+  std::string printed;
+  llvm::raw_string_ostream os(printed);
+  funcDecl->print(os, funcDecl->getASTContext().getPrintingPolicy());
+  return os.str();
+}
+
+}  // namespace
+
+/* ResultCache */
+
+ResultCache::ResultCache(std::string directory) : directory(std::move(directory)) {
+  if (std::error_code ec = llvm::sys::fs::create_directories(this->directory)) {
+    llvm::errs() << "WARNING: Could not create cache directory '" << this->directory << "': " << ec.message()
+                 << "\n";
+  }
+}
+
+std::string ResultCache::computeKey(const FunctionDecl *funcDecl, llvm::StringRef settings, FunctionIndex *index) {
+  llvm::SHA1 hash;
+  addToHash(hash, SPFIE_VERSION);
+  addToHash(hash, SPFIE_BUILD_ID);
+  addToHash(hash, settings);
+  addToHash(hash, printFunction(funcDecl));
+
+  // gather all functions reachable through calls, each printed once, in a
+  // deterministic order
+  std::set<const FunctionDecl *> visited = {funcDecl->getCanonicalDecl()};
+  std::vector<const FunctionDecl *> toVisit = {funcDecl};
+  std::set<std::string> calleeSources;
+  while (!toVisit.empty()) {
+    const FunctionDecl *current = toVisit.back();
+    toVisit.pop_back();
+    CalleeCollector collector;
+    collector.TraverseDecl(const_cast<FunctionDecl *>(current));
+    for (const auto *callee: collector.callees) {
+      if (!visited.insert(callee->getCanonicalDecl()).second) {
+        continue;
+      }
+      // use the definition if there is one, otherwise just the declaration
+      const FunctionDecl *calleeDefinition = callee->getDefinition();
+      if (!calleeDefinition && index) {
+        if (auto indexed = index->findDefinition(callee)) {
+          calleeDefinition = indexed->decl;
+        } else {
+          // translation will fail, so the key doesn't matter
+          llvm::consumeError(indexed.takeError());
+        }
+      }
+      if (calleeDefinition) {
+        toVisit.push_back(calleeDefinition);
+      }
+      calleeSources.insert(printFunction(calleeDefinition ? calleeDefinition : callee));
+    }
+  }
+  for (const auto &calleeSource: calleeSources) {
+    addToHash(hash, calleeSource);
+  }
+
+  return llvm::toHex(hash.final(), true);
+}
+
+bool ResultCache::lookup(const std::string &key, std::string &result) const {
+  auto buffer = llvm::MemoryBuffer::getFile(getPath(key));
+  if (!buffer) {
+    return false;
+  }
+  result = (*buffer)->getBuffer().str();
+  return true;
+}
+
+void ResultCache::store(const std::string &key, const std::string &result) const {
+  // write to a temporary file and rename it into place, so that concurrent
+  // readers never see a partial result
+  int fd;
+  llvm::SmallString<128> tempPath;
+  llvm::SmallString<128> tempModel(directory);
+  llvm::sys::path::append(tempModel, key + "-%%%%%%.tmp");
+  if (std::error_code ec = llvm::sys::fs::createUniqueFile(tempModel, fd, tempPath)) {
+    llvm::errs() << "WARNING: Could not write to cache directory '" << directory << "': " << ec.message() << "\n";
+    return;
+  }
+  {
+    llvm::raw_fd_ostream tempFile(fd, true);
+    tempFile << result;
+  }
+  if (std::error_code ec = llvm::sys::fs::rename(tempPath, getPath(key))) {
+    llvm::errs() << "WARNING: Could not store result in cache directory '" << directory << "': " << ec.message()
+                 << "\n";
+    llvm::sys::fs::remove(tempPath);
+  }
+}
+
+std::string ResultCache::getPath(const std::string &key) const {
+  llvm::SmallString<128> path(directory);
+  llvm::sys::path::append(path, key + ".out");
+  return path.str().str();
+}
+
+}  // namespace spf_ie
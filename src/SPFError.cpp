@@ -0,0 +1,50 @@
+#include "SPFError.hpp"
+
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "Driver.hpp"
+#include "Utils.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* SPFError */
+
+char SPFError::ID;
+
+SPFError::SPFError(std::string message, const clang::Stmt *stmt) : message(std::move(message)) {
+  if (!stmt) {
+    return;
+  }
+  PresumedLoc location = Context->getSourceManager().getPresumedLoc(stmt->getBeginLoc());
+  if (location.isValid()) {
+    fileName = location.getFilename();
+    line = location.getLine();
+    column = location.getColumn();
+  }
+  sourceCode = Utils::stmtToString(stmt).str();
+}
+
+void SPFError::log(llvm::raw_ostream &os) const {
+  os << message;
+  if (line) {
+    os << "\nAt " << fileName << ":" << line << ":" << column << ":";
+  }
+  if (!sourceCode.empty()) {
+    os << "\n" << sourceCode;
+  }
+}
+
+std::error_code SPFError::convertToErrorCode() const {
+  return llvm::inconvertibleErrorCode();
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,154 @@
+#include "SPFPrinter.hpp"
+
+#include <string>
+#include <vector>
+
+#include "Driver.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+/* SPFPrinter */
+
+SPFPrinter::SPFPrinter(const SourceManager &sourceManager,
+                       const LangOptions &langOpts, bool arraysAsCalls,
+                       const CallReplacements *callReplacements)
+    : sourceManager(sourceManager), langOpts(langOpts),
+      arraysAsCalls(arraysAsCalls), callReplacements(callReplacements) {}
+
+bool SPFPrinter::print(const clang::Stmt *stmt, bool arraysAsCalls,
+                       const CallReplacements *callReplacements,
+                       std::string &result) {
+  SPFPrinter printer(Context->getSourceManager(), Context->getLangOpts(),
+                     arraysAsCalls, callReplacements);
+  std::string printed = printer.printSeparately(stmt);
+  if (printer.failed) {
+    return false;
+  }
+  result = std::move(printed);
+  return true;
+}
+
+void SPFPrinter::VisitStmt(const clang::Stmt *stmt) {
+  for (const auto *child: stmt->children()) {
+    if (child && !failed) {
+      Visit(child);
+    }
+  }
+}
+
+void SPFPrinter::VisitArraySubscriptExpr(const ArraySubscriptExpr *expr) {
+  if (!arraysAsCalls) {
+    VisitStmt(expr);
+    return;
+  }
+  unsigned begin, end;
+  if (!getOffsets(expr, begin, end)) {
+    failed = true;
+    return;
+  }
+  // collect indexes from the outermost dimension in
+  std::vector<const Expr *> indexes;
+  const Expr *base = expr;
+  while (const auto *asArrayAccess = dyn_cast<ArraySubscriptExpr>(base)) {
+    indexes.push_back(asArrayAccess->getIdx()->IgnoreParenImpCasts());
+    base = asArrayAccess->getBase()->IgnoreParenImpCasts();
+  }
+  std::string text = printSeparately(base) + "(";
+  for (auto it = indexes.rbegin(); it != indexes.rend(); ++it) {
+    if (it != indexes.rbegin()) {
+      text += ",";
+    }
+    text += printSeparately(*it);
+  }
+  text += ")";
+  replaceRange(begin, end, text);
+}
+
+void SPFPrinter::VisitCallExpr(const CallExpr *expr) {
+  if (callReplacements) {
+    auto it = callReplacements->find(expr);
+    if (it != callReplacements->end()) {
+      unsigned begin, end;
+      if (!getOffsets(expr, begin, end)) {
+        failed = true;
+        return;
+      }
+      replaceRange(begin, end, it->second);
+      return;
+    }
+  }
+  VisitStmt(expr);
+}
+
+bool SPFPrinter::getOffsets(const clang::Stmt *node, unsigned &begin,
+                            unsigned &end) {
+  CharSourceRange range = Lexer::makeFileCharRange(
+      CharSourceRange::getTokenRange(node->getSourceRange()), sourceManager,
+      langOpts);
+  if (range.isInvalid()) {
+    return false;
+  }
+  auto beginLoc = sourceManager.getDecomposedLoc(range.getBegin());
+  auto endLoc = sourceManager.getDecomposedLoc(range.getEnd());
+  if (beginLoc.first != endLoc.first || beginLoc.second > endLoc.second) {
+    return false;
+  }
+  if (file.isInvalid()) {
+    bool invalid = false;
+    buffer = sourceManager.getBufferData(beginLoc.first, &invalid);
+    if (invalid) {
+      return false;
+    }
+    file = beginLoc.first;
+  } else if (beginLoc.first != file) {
+    return false;
+  }
+  begin = beginLoc.second;
+  end = endLoc.second;
+  return true;
+}
+
+void SPFPrinter::printUpTo(unsigned offset) {
+  if (offset < cursor || offset > buffer.size()) {
+    // rewritten nodes overlap, which happens when they come from macros
+    failed = true;
+    return;
+  }
+  out.append(buffer.data() + cursor, offset - cursor);
+  cursor = offset;
+}
+
+std::string SPFPrinter::printSeparately(const clang::Stmt *node) {
+  unsigned begin, end;
+  if (!getOffsets(node, begin, end)) {
+    failed = true;
+    return "";
+  }
+  unsigned outerCursor = cursor;
+  std::string outerOut = std::move(out);
+  out.clear();
+  cursor = begin;
+  Visit(node);
+  printUpTo(end);
+  std::string printed = std::move(out);
+  out = std::move(outerOut);
+  cursor = outerCursor;
+  return printed;
+}
+
+void SPFPrinter::replaceRange(unsigned begin, unsigned end,
+                              const std::string &text) {
+  printUpTo(begin);
+  out += text;
+  cursor = end;
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,379 @@
+/*!
+ * \file Server.cpp
+ *
+ * \brief Persistent server mode for spf-ie.
+ */
+
+#include "Server.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Driver.hpp"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace clang::tooling;
+
+namespace spf_ie {
+
+namespace {
+
+//! A file whose contents are already in memory
+class CachedFile : public llvm::vfs::File {
+public:
+  CachedFile(llvm::vfs::Status fileStatus, std::shared_ptr<llvm::MemoryBuffer> contents)
+      : fileStatus(std::move(fileStatus)), contents(std::move(contents)) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status() override { return fileStatus; }
+
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(
+      const llvm::Twine &name, int64_t fileSize, bool requiresNullTerminator, bool isVolatile) override {
+    return llvm::MemoryBuffer::getMemBuffer(contents->getBuffer(), name.str(), requiresNullTerminator);
+  }
+
+  std::error_code close() override { return std::error_code(); }
+
+private:
+  llvm::vfs::Status fileStatus;
+  std::shared_ptr<llvm::MemoryBuffer> contents;
+};
+
+//! A file system which keeps the contents of every file read through it, and
+//! reuses them as long as the file's size and modification time are unchanged
+class ContentCachingFileSystem : public llvm::vfs::ProxyFileSystem {
+public:
+  explicit ContentCachingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> underlying)
+      : ProxyFileSystem(std::move(underlying)) {}
+
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine &path) override {
+    auto file = getUnderlyingFS().openFileForRead(path);
+    if (!file) {
+      return file;
+    }
+    auto fileStatus = (*file)->status();
+    if (!fileStatus) {
+      return file;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CacheEntry &entry = cache[path.str()];
+    if (!entry.contents || entry.modificationTime != fileStatus->getLastModificationTime() ||
+        entry.contents->getBufferSize() != fileStatus->getSize()) {
+      auto contents = (*file)->getBuffer(path, fileStatus->getSize(), true, false);
+      if (!contents) {
+        return contents.getError();
+      }
+      entry.contents = std::move(*contents);
+      entry.modificationTime = fileStatus->getLastModificationTime();
+    }
+    return std::unique_ptr<llvm::vfs::File>(new CachedFile(*fileStatus, entry.contents));
+  }
+
+private:
+  struct CacheEntry {
+    std::shared_ptr<llvm::MemoryBuffer> contents;
+    llvm::sys::TimePoint<> modificationTime;
+  };
+
+  std::map<std::string, CacheEntry> cache;
+  std::mutex cacheMutex;
+};
+
+//! Write all of the given data to a socket
+//! \return false if writing failed
+bool writeAll(int connection, llvm::StringRef data) {
+  while (!data.empty()) {
+    ssize_t written = write(connection, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data = data.drop_front(written);
+  }
+  return true;
+}
+
+//! Send a response to a request
+void sendResponse(int connection, bool success, const std::string &body) {
+  std::string header = std::string("status: ") + (success ? "ok" : "error") + "\n" +
+      "content-length: " + std::to_string(body.size()) + "\n\n";
+  if (!writeAll(connection, header) || !writeAll(connection, body)) {
+    llvm::errs() << "Failed to send response: " << std::strerror(errno) << "\n";
+  }
+}
+
+//! Get the directory holding the default socket
+std::string getDefaultSocketDir() {
+  const char *runtimeDir = std::getenv("XDG_RUNTIME_DIR");
+  if (runtimeDir && *runtimeDir) {
+    return runtimeDir;
+  }
+  return "/tmp/spf-ie-" + std::to_string(getuid());
+}
+
+//! Check whether there is a socket at a path, without following symlinks
+bool isSocket(const std::string &path) {
+  struct stat pathStatus;
+  return lstat(path.c_str(), &pathStatus) == 0 && S_ISSOCK(pathStatus.st_mode);
+}
+
+}  // namespace
+
+std::string SPFServer::getDefaultSocketPath() {
+  return getDefaultSocketDir() + "/spf-ie.sock";
+}
+
+SPFServer::SPFServer(const CompilationDatabase &compilations, std::string socketPath,
+                     TranslationRequest defaults)
+    : compilations(compilations),
+      socketPath(socketPath.empty() ? getDefaultSocketPath() : std::move(socketPath)),
+      defaults(std::move(defaults)),
+      fileSystem(new ContentCachingFileSystem(llvm::vfs::getRealFileSystem())) {}
+
+bool SPFServer::prepareSocketPath() {
+  if (socketPath == getDefaultSocketPath()) {
+    // the directory must be this user's alone, or others could swap the
+    // socket out from under clients
+    std::string directory = getDefaultSocketDir();
+    if (mkdir(directory.c_str(), 0700) < 0 && errno != EEXIST) {
+      llvm::errs() << "Could not create socket directory '" << directory << "': " << std::strerror(errno) << "\n";
+      return false;
+    }
+    struct stat dirStatus;
+    if (lstat(directory.c_str(), &dirStatus) < 0 || !S_ISDIR(dirStatus.st_mode) || dirStatus.st_uid != getuid() ||
+        (dirStatus.st_mode & (S_IRWXG | S_IRWXO))) {
+      llvm::errs() << "Socket directory '" << directory
+                   << "' must be a directory owned by and only accessible to the current user\n";
+      return false;
+    }
+  }
+
+  struct stat pathStatus;
+  if (lstat(socketPath.c_str(), &pathStatus) == 0) {
+    if (!S_ISSOCK(pathStatus.st_mode)) {
+      llvm::errs() << "Refusing to replace '" << socketPath << "', which is not a socket\n";
+      return false;
+    }
+    // left behind by a server which did not shut down cleanly
+    unlink(socketPath.c_str());
+  }
+  return true;
+}
+
+int SPFServer::run() {
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    llvm::errs() << "Could not create socket: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    llvm::errs() << "Socket path '" << socketPath << "' is too long\n";
+    close(listener);
+    return 1;
+  }
+  std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+  if (!prepareSocketPath()) {
+    close(listener);
+    return 1;
+  }
+  // only this user may connect, so requests cannot read files for others;
+  // the umask makes the socket so from the moment it exists
+  mode_t oldUmask = umask(0177);
+  int bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+  umask(oldUmask);
+  if (bound < 0 || chmod(socketPath.c_str(), 0600) < 0 || listen(listener, 16) < 0) {
+    llvm::errs() << "Could not listen on '" << socketPath << "': " << std::strerror(errno) << "\n";
+    close(listener);
+    return 1;
+  }
+  llvm::errs() << "spf-ie server listening on " << socketPath << "\n";
+
+  bool running = true;
+  int status = 0;
+  while (running) {
+    int connection = accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      llvm::errs() << "Failed to accept connection: " << std::strerror(errno) << "\n";
+      status = 1;
+      break;
+    }
+    running = handleConnection(connection);
+    close(connection);
+  }
+
+  close(listener);
+  if (isSocket(socketPath)) {
+    unlink(socketPath.c_str());
+  }
+  return status;
+}
+
+bool SPFServer::handleConnection(int connection) {
+  // read up to the end of the headers, possibly along with part of the contents
+  std::string received;
+  size_t headersEnd;
+  char buffer[4096];
+  while ((headersEnd = received.find("\n\n")) == std::string::npos) {
+    ssize_t numRead = read(connection, buffer, sizeof(buffer));
+    if (numRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (numRead <= 0) {
+      sendResponse(connection, false, "Connection closed before end of request headers\n");
+      return true;
+    }
+    received.append(buffer, numRead);
+    if (received.find("\n\n") == std::string::npos && received.size() > MaxHeaderLength) {
+      sendResponse(connection, false, "Request headers are longer than " + std::to_string(MaxHeaderLength) +
+          " bytes\n");
+      return true;
+    }
+  }
+
+  std::map<std::string, std::string> headers;
+  llvm::SmallVector<llvm::StringRef, 8> lines;
+  llvm::StringRef(received).take_front(headersEnd).split(lines, '\n', -1, false);
+  for (const auto &line: lines) {
+    std::pair<llvm::StringRef, llvm::StringRef> keyAndValue = line.split(':');
+    headers[keyAndValue.first.trim().lower()] = keyAndValue.second.trim().str();
+  }
+
+  if (headers["mode"] == "shutdown") {
+    sendResponse(connection, true, "");
+    return false;
+  }
+
+  // read in-memory file contents, if any
+  std::unique_ptr<std::string> contents;
+  if (headers.count("content-length")) {
+    unsigned long long length;
+    if (llvm::getAsUnsignedInteger(headers["content-length"], 10, length)) {
+      sendResponse(connection, false, "Invalid content-length '" + headers["content-length"] + "'\n");
+      return true;
+    }
+    if (length > MaxContentLength) {
+      sendResponse(connection, false, "content-length " + std::to_string(length) + " exceeds the limit of " +
+          std::to_string(MaxContentLength) + " bytes\n");
+      return true;
+    }
+    contents.reset(new std::string(received.substr(headersEnd + 2)));
+    while (contents->size() < length) {
+      ssize_t numRead = read(connection, buffer, sizeof(buffer));
+      if (numRead < 0 && errno == EINTR) {
+        continue;
+      }
+      if (numRead <= 0) {
+        sendResponse(connection, false, "Connection closed before end of file contents\n");
+        return true;
+      }
+      contents->append(buffer, numRead);
+    }
+    contents->resize(length);
+  }
+
+  std::string response;
+  bool success = translate(headers, contents.get(), response);
+  sendResponse(connection, success, response);
+  return true;
+}
+
+bool SPFServer::translate(const std::map<std::string, std::string> &headers, const std::string *contents,
+                          std::string &response) {
+  auto header = [&headers](const std::string &key) {
+    auto it = headers.find(key);
+    return (it == headers.end() ? std::string() : it->second);
+  };
+
+  std::string sourcePath = header("source");
+  if (sourcePath.empty()) {
+    response = "Request must specify a source file\n";
+    return false;
+  }
+  TranslationRequest request = defaults;
+  std::string mode = header("mode");
+  if (mode == "ir") {
+    request.frontendOnly = true;
+  } else if (!mode.empty() && mode != "codegen") {
+    response = "Unknown mode '" + mode + "'\n";
+    return false;
+  }
+  std::string backend = header("codegen");
+  if (backend == "omega") {
+    request.codeGenBackend = CodeGenBackend::Omega;
+  } else if (backend == "isl") {
+    request.codeGenBackend = CodeGenBackend::Isl;
+  } else if (!backend.empty()) {
+    response = "Unknown codegen backend '" + backend + "'\n";
+    return false;
+  }
+  request.allFunctions = (header("all-functions") == "true");
+  std::string entryPointList = header("entry-point");
+  llvm::SmallVector<llvm::StringRef, 4> entryPoints;
+  llvm::SplitString(entryPointList, entryPoints, ", ");
+  for (const auto &entryPoint: entryPoints) {
+    request.entryPoints.push_back(entryPoint.str());
+  }
+  if (request.entryPoints.empty() && !request.allFunctions) {
+    response = "Request must specify entry-point or all-functions\n";
+    return false;
+  }
+
+  ClangTool tool(compilations, sourcePath, std::make_shared<PCHContainerOperations>(), fileSystem);
+  if (contents) {
+    tool.mapVirtualFile(sourcePath, *contents);
+  }
+  std::string diagnostics;
+  llvm::raw_string_ostream diagnosticStream(diagnostics);
+  TextDiagnosticPrinter diagnosticPrinter(diagnosticStream, new DiagnosticOptions());
+  tool.setDiagnosticConsumer(&diagnosticPrinter);
+
+  std::string result;
+  llvm::raw_string_ostream resultStream(result);
+  TranslationOutcome outcome;
+  bool success = !tool.run(newSPFActionFactory(request, resultStream, outcome).get());
+  resultStream.flush();
+
+  for (const auto &error: outcome.errors) {
+    diagnosticStream << error << "\n";
+    success = false;
+  }
+  if (!request.allFunctions) {
+    for (const auto &entryPoint: request.entryPoints) {
+      if (!outcome.foundEntryPoints.count(entryPoint)) {
+        diagnosticStream << "Could not locate definition of the target function '" << entryPoint << "'!\n";
+        success = false;
+      }
+    }
+  }
+  diagnosticStream.flush();
+  response = (success ? result : diagnostics);
+  return success;
+}
+
+}  // namespace spf_ie
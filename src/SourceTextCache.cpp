@@ -0,0 +1,48 @@
+#include "SourceTextCache.hpp"
+
+#include "Driver.hpp"
+#include "Stats.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/StringRef.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+namespace {
+
+llvm::StringRef getSourceText(const clang::Stmt *stmt) {
+  return Lexer::getSourceText(
+      CharSourceRange::getTokenRange(stmt->getSourceRange()),
+      Context->getSourceManager(), Context->getLangOpts());
+}
+
+}  // namespace
+
+/* SourceTextCache */
+
+thread_local SourceTextCache *SourceTextCache::active = nullptr;
+
+SourceTextCache::SourceTextCache() : previous(active) { active = this; }
+
+SourceTextCache::~SourceTextCache() { active = previous; }
+
+llvm::StringRef SourceTextCache::lookup(const clang::Stmt *stmt) {
+  if (!active) {
+    return getSourceText(stmt);
+  }
+  auto it = active->texts.find(stmt);
+  if (it != active->texts.end()) {
+    Stats::increment(Stats::SourceTextHits);
+    return it->second;
+  }
+  Stats::increment(Stats::SourceTextMisses);
+  llvm::StringRef text = getSourceText(stmt);
+  active->texts.try_emplace(stmt, text);
+  return text;
+}
+
+}  // namespace spf_ie
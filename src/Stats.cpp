@@ -0,0 +1,130 @@
+#include "Stats.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace spf_ie {
+
+namespace {
+
+//! Names used in reports, with underscores printed as spaces in human-readable form
+const char *const phaseNames[Stats::NumPhases] = {
+    "parse", "process_body", "position_strings", "position_sets", "iegenlib_parsing", "finalize", "codegen"};
+const char *const counterNames[Stats::NumCounters] = {
+    "statements_added", "data_accesses_recorded", "functions_inlined", "calls_outlined", "statements_merged",
+    "declarations_folded", "constraints_removed", "isl_fallbacks", "replace_in_string_calls", "cache_hits",
+    "cache_misses", "string_fallbacks", "source_text_hits", "source_text_misses", "foreign_files_parsed",
+    "summary_hits", "summary_misses"};
+
+std::atomic<bool> enabled(false);
+std::atomic<uint64_t> phaseNanoseconds[Stats::NumPhases];
+std::atomic<uint64_t> phaseCalls[Stats::NumPhases];
+std::atomic<uint64_t> counters[Stats::NumCounters];
+//! How many calls to each phase are currently running on this thread
+thread_local unsigned int phaseDepth[Stats::NumPhases];
+
+std::string humanReadableName(const char *name) {
+  std::string readable = name;
+  for (auto &c: readable) {
+    if (c == '_') {
+      c = ' ';
+    }
+  }
+  return readable;
+}
+
+double toMilliseconds(uint64_t nanoseconds) {
+  return nanoseconds / 1e6;
+}
+
+}  // namespace
+
+/* Stats */
+
+void Stats::enable() {
+  enabled = true;
+}
+
+bool Stats::isEnabled() {
+  return enabled;
+}
+
+void Stats::increment(Counter counter, uint64_t amount) {
+  if (enabled) {
+    counters[counter] += amount;
+  }
+}
+
+void Stats::recordPhase(Phase phase, std::chrono::nanoseconds elapsed) {
+  phaseCalls[phase]++;
+  phaseNanoseconds[phase] += elapsed.count();
+}
+
+void Stats::print(llvm::raw_ostream &os) {
+  os << "===-------------------------------------------------===\n"
+     << "                   spf-ie statistics\n"
+     << "===-------------------------------------------------===\n"
+     << llvm::format("%-28s %10s %14s\n", "Phase", "Calls", "Time (ms)");
+  for (unsigned int i = 0; i < NumPhases; ++i) {
+    os << llvm::format("%-28s %10llu %14.3f\n", humanReadableName(phaseNames[i]).c_str(),
+                       (unsigned long long) phaseCalls[i], toMilliseconds(phaseNanoseconds[i]));
+  }
+  os << "\n" << llvm::format("%-28s %10s\n", "Counter", "Value");
+  for (unsigned int i = 0; i < NumCounters; ++i) {
+    os << llvm::format("%-28s %10llu\n", humanReadableName(counterNames[i]).c_str(),
+                       (unsigned long long) counters[i]);
+  }
+}
+
+void Stats::printJSON(llvm::raw_ostream &os) {
+  llvm::json::OStream json(os, 2);
+  json.object([&] {
+    json.attributeObject("phases", [&] {
+      for (unsigned int i = 0; i < NumPhases; ++i) {
+        json.attributeObject(phaseNames[i], [&] {
+          json.attribute("calls", (int64_t) phaseCalls[i]);
+          json.attribute("time_ms", toMilliseconds(phaseNanoseconds[i]));
+        });
+      }
+    });
+    json.attributeObject("counters", [&] {
+      for (unsigned int i = 0; i < NumCounters; ++i) {
+        json.attribute(counterNames[i], (int64_t) counters[i]);
+      }
+    });
+  });
+  os << "\n";
+}
+
+/* PhaseTimer */
+
+PhaseTimer::PhaseTimer(Stats::Phase phase)
+    : phase(phase), running(Stats::isEnabled()), outermost(false) {
+  if (running) {
+    outermost = (phaseDepth[phase]++ == 0);
+    if (outermost) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  stop();
+}
+
+void PhaseTimer::stop() {
+  if (!running) {
+    return;
+  }
+  running = false;
+  phaseDepth[phase]--;
+  Stats::recordPhase(phase, outermost ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start) : std::chrono::nanoseconds(0));
+}
+
+}  // namespace spf_ie
@@ -0,0 +1,211 @@
+#include "SummaryStore.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ResultCache.hpp"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "iegenlib.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace spf_ie {
+
+namespace {
+
+using StringPairs = std::vector<std::pair<std::string, std::string>>;
+
+llvm::Error makeSummaryError(const std::string &message) {
+  return llvm::make_error<llvm::StringError>("Malformed summary: " + message, llvm::inconvertibleErrorCode());
+}
+
+//! Write a pair of strings as a two-element array
+void writePair(llvm::json::OStream &json, const std::string &first, const std::string &second) {
+  json.array([&] {
+    json.value(first);
+    json.value(second);
+  });
+}
+
+//! Read an array of two-element arrays of strings from an object
+llvm::Error readPairs(const llvm::json::Object &object, llvm::StringRef key, StringPairs &pairs) {
+  const auto *array = object.getArray(key);
+  if (!array) {
+    return makeSummaryError("missing '" + key.str() + "'");
+  }
+  for (const auto &element: *array) {
+    const auto *pair = element.getAsArray();
+    if (!pair || pair->size() != 2 || !(*pair)[0].getAsString() || !(*pair)[1].getAsString()) {
+      return makeSummaryError("'" + key.str() + "' must hold pairs of strings");
+    }
+    pairs.emplace_back((*pair)[0].getAsString()->str(), (*pair)[1].getAsString()->str());
+  }
+  return llvm::Error::success();
+}
+
+}  // namespace
+
+/* SummaryStore */
+
+SummaryStore::SummaryStore(std::string directory) : files(std::move(directory)) {}
+
+std::string SummaryStore::computeSourceKey(const FunctionDecl *funcDecl) {
+  const ASTContext &context = funcDecl->getASTContext();
+  return ResultCache::computeKey(
+      funcDecl, "summary;signature=" + context.getCanonicalType(funcDecl->getType()).getAsString());
+}
+
+std::string SummaryStore::computeKey(const std::string &sourceKey, llvm::StringRef settings) {
+  // summaries built with the default options keep their source keys
+  if (settings.empty()) {
+    return sourceKey;
+  }
+  llvm::SHA1 hash;
+  hash.update(sourceKey);
+  hash.update(llvm::StringRef("\0", 1));
+  hash.update(settings);
+  return llvm::toHex(hash.final(), true);
+}
+
+iegenlib::Computation *SummaryStore::load(const std::string &key) const {
+  std::string summary;
+  if (!files.lookup(key, summary)) {
+    return nullptr;
+  }
+  auto computation = deserialize(summary);
+  if (!computation) {
+    // rebuilding, and then storing over the bad summary, fixes it
+    llvm::errs() << "WARNING: Ignoring summary " << key << ": " << llvm::toString(computation.takeError()) << "\n";
+    return nullptr;
+  }
+  return *computation;
+}
+
+void SummaryStore::store(const std::string &key, const iegenlib::Computation *computation) const {
+  files.store(key, serialize(computation));
+}
+
+std::string SummaryStore::serialize(const iegenlib::Computation *computation) {
+  std::string summary;
+  llvm::raw_string_ostream os(summary);
+  llvm::json::OStream json(os);
+  json.object([&] {
+    json.attribute("name", computation->getName());
+    json.attributeArray("parameters", [&] {
+      for (unsigned int i = 0; i < computation->getNumParams(); ++i) {
+        writePair(json, computation->getParameterName(i), computation->getParameterType(i));
+      }
+    });
+    json.attributeArray("data_spaces", [&] {
+      for (const auto &dataSpace: computation->getDataSpaces()) {
+        writePair(json, dataSpace.first, dataSpace.second);
+      }
+    });
+    json.attributeArray("statements", [&] {
+      for (unsigned int i = 0; i < computation->getNumStmts(); ++i) {
+        const iegenlib::Stmt *stmt = computation->getStmt(i);
+        json.object([&] {
+          json.attribute("source", stmt->getStmtSourceCode());
+          json.attribute("iteration_space", stmt->getIterationSpace()->prettyPrintString());
+          json.attribute("execution_schedule", stmt->getExecutionSchedule()->prettyPrintString());
+          json.attributeArray("reads", [&] {
+            for (unsigned int j = 0; j < stmt->getNumReads(); ++j) {
+              writePair(json, stmt->getReadDataSpace(j), stmt->getReadRelation(j)->prettyPrintString());
+            }
+          });
+          json.attributeArray("writes", [&] {
+            for (unsigned int j = 0; j < stmt->getNumWrites(); ++j) {
+              writePair(json, stmt->getWriteDataSpace(j), stmt->getWriteRelation(j)->prettyPrintString());
+            }
+          });
+        });
+      }
+    });
+    json.attributeArray("return_values", [&] {
+      for (const auto &returnValue: computation->getReturnValues()) {
+        json.array([&] {
+          json.value(returnValue.first);
+          json.value(returnValue.second);
+        });
+      }
+    });
+  });
+  return os.str();
+}
+
+llvm::Expected<iegenlib::Computation *> SummaryStore::deserialize(llvm::StringRef summary) {
+  auto parsed = llvm::json::parse(summary);
+  if (!parsed) {
+    return parsed.takeError();
+  }
+  const auto *object = parsed->getAsObject();
+  if (!object || !object->getString("name")) {
+    return makeSummaryError("missing 'name'");
+  }
+  StringPairs parameters;
+  StringPairs dataSpaces;
+  if (auto error = readPairs(*object, "parameters", parameters)) {
+    return std::move(error);
+  }
+  if (auto error = readPairs(*object, "data_spaces", dataSpaces)) {
+    return std::move(error);
+  }
+  const auto *stmts = object->getArray("statements");
+  const auto *returnValues = object->getArray("return_values");
+  if (!stmts || !returnValues) {
+    return makeSummaryError("missing 'statements' or 'return_values'");
+  }
+
+  auto computation = std::unique_ptr<iegenlib::Computation>(
+      new iegenlib::Computation(object->getString("name")->str()));
+  for (const auto &parameter: parameters) {
+    computation->addParameter(parameter.first, parameter.second);
+  }
+  // parameters are data spaces already
+  for (const auto &dataSpace: dataSpaces) {
+    if (!computation->isDataSpace(dataSpace.first)) {
+      computation->addDataSpace(dataSpace.first, dataSpace.second);
+    }
+  }
+  for (const auto &element: *stmts) {
+    const auto *stmt = element.getAsObject();
+    if (!stmt || !stmt->getString("source") || !stmt->getString("iteration_space") ||
+        !stmt->getString("execution_schedule")) {
+      return makeSummaryError("statements must have 'source', 'iteration_space' and 'execution_schedule'");
+    }
+    StringPairs reads;
+    StringPairs writes;
+    if (auto error = readPairs(*stmt, "reads", reads)) {
+      return std::move(error);
+    }
+    if (auto error = readPairs(*stmt, "writes", writes)) {
+      return std::move(error);
+    }
+    computation->addStmt(new iegenlib::Stmt(stmt->getString("source")->str(),
+                                            stmt->getString("iteration_space")->str(),
+                                            stmt->getString("execution_schedule")->str(), reads, writes));
+  }
+  for (const auto &element: *returnValues) {
+    const auto *returnValue = element.getAsArray();
+    if (!returnValue || returnValue->size() != 2 || !(*returnValue)[0].getAsString() ||
+        !(*returnValue)[1].getAsBoolean()) {
+      return makeSummaryError("'return_values' must hold pairs of a name and whether it is a data space");
+    }
+    computation->addReturnValue((*returnValue)[0].getAsString()->str(), *(*returnValue)[1].getAsBoolean());
+  }
+
+  if (!computation->isComplete()) {
+    return makeSummaryError("Computation is incomplete");
+  }
+  return computation.release();
+}
+
+}  // namespace spf_ie
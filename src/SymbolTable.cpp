@@ -0,0 +1,24 @@
+#include "SymbolTable.hpp"
+
+#include "llvm/ADT/StringRef.h"
+
+namespace spf_ie {
+
+/* SymbolTable */
+
+const SymbolId SymbolTable::NoSymbol;
+
+SymbolId SymbolTable::intern(llvm::StringRef name) {
+  auto inserted = ids.try_emplace(name, names.size());
+  if (inserted.second) {
+    names.push_back(inserted.first->getKey());
+  }
+  return inserted.first->getValue();
+}
+
+SymbolId SymbolTable::lookup(llvm::StringRef name) const {
+  auto it = ids.find(name);
+  return it == ids.end() ? NoSymbol : it->getValue();
+}
+
+}  // namespace spf_ie
@@ -5,13 +5,14 @@
 #include <sstream>
 
 #include "Driver.hpp"
+#include "SPFError.hpp"
+#include "SourceTextCache.hpp"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/Expr.h"
 #include "clang/AST/Stmt.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Basic/SourceManager.h"
-#include "clang/Lex/Lexer.h"
 
 using namespace clang;
 
@@ -29,15 +30,16 @@ void Utils::printErrorAndExit(const std::string &message, clang::Stmt *stmt) {
               << stmt->getBeginLoc().printToString(
                   Context->getSourceManager())
               << ":\n"
-              << stmtToString(stmt) << "\n";
+              << stmtToString(stmt).str() << "\n";
   printErrorAndExit(fullMessage.str());
 }
 
-std::string Utils::stmtToString(clang::Stmt *stmt) {
-  return Lexer::getSourceText(
-      CharSourceRange::getTokenRange(stmt->getSourceRange()),
-      Context->getSourceManager(), Context->getLangOpts())
-      .str();
+void Utils::raiseError(const std::string &message, const clang::Stmt *stmt) {
+  throw SPFError(message, stmt);
+}
+
+llvm::StringRef Utils::stmtToString(const clang::Stmt *stmt) {
+  return SourceTextCache::lookup(stmt);
 }
 
 std::string Utils::typeToArrayStrippedString(const clang::Type *originalType) {
@@ -50,7 +52,7 @@ std::string Utils::typeToArrayStrippedString(const clang::Type *originalType) {
 
 std::string Utils::binaryOperatorKindToString(BinaryOperatorKind bo) {
   if (!operatorStrings.count(bo)) {
-    printErrorAndExit("Invalid operator type encountered.");
+    raiseError("Invalid operator type encountered.");
   }
   return operatorStrings.at(bo);
 }
@@ -75,19 +77,13 @@ void Utils::collectComponentsFromCompoundExpr(
       || (includeCallExprs && isa<CallExpr>(usableExpr))) {
     currentList.push_back(usableExpr);
   } else if (!Utils::isVarOrNumericLiteral(usableExpr)) {
-    Utils::printErrorAndExit("Failed to process components of complex expression", expr);
+    Utils::raiseError("Failed to process components of complex expression", expr);
   }
 }
 
-std::string Utils::getVarReplacementName() {
-  return REPLACEMENT_VAR_BASE_NAME + std::to_string(replacementVarNumber++);
-}
-
 const std::map<BinaryOperatorKind, std::string> Utils::operatorStrings = {
     {BinaryOperatorKind::BO_LT, "<"}, {BinaryOperatorKind::BO_LE, "<="},
     {BinaryOperatorKind::BO_GT, ">"}, {BinaryOperatorKind::BO_GE, ">="},
     {BinaryOperatorKind::BO_EQ, "="}, {BinaryOperatorKind::BO_NE, "!="}};
 
-unsigned int Utils::replacementVarNumber = 0;
-
 }  // namespace spf_ie